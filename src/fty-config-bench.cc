@@ -0,0 +1,573 @@
+/*  =========================================================================
+    fty-config-bench - Benchmark of the fty-config save and restore
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+ */
+
+/*
+@header
+    fty-config-bench - Benchmark of the fty-config save and restore
+@discuss
+    Runs the real ConfigurationManager on generated configuration files, through an
+    in-process message bus, with a temporary directory as Augeas root. Each scenario
+    alternates two variants of the same files: every save exports a modified file, every
+    restore writes all the values back.
+    Reported per operation: wall time, ns per generated node, C++ allocations (all threads,
+    in total and per node; libaugeas allocates with malloc, not counted),
+    the growth of the resident memory over the operation and the growth of the peak RSS
+    over the scenario, which runs after the smaller ones.
+    The file scenarios run with plain payloads, then with zstd compressed payloads
+    (suffixed "-zstd"), and print the size of the payload.
+    The document scenarios export and read back multi-MB documents of duplicated keys
+    and ifaces, without Augeas: they measure the throughput of the JSON writer and reader.
+@end
+ */
+
+#include "fty-config.h"
+#include "fty_config_compression.h"
+#include "fty_config_document.h"
+#include "fty_config_json_reader.h"
+#include "fty_config_manager.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <ftw.h>
+#include <functional>
+#include <fty_log.h>
+#include <fty_srr_dto.h>
+#include <list>
+#include <map>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// Allocations of the process, all threads
+static std::atomic<uint64_t> g_allocations{0};
+
+void* operator new(size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+namespace {
+
+constexpr auto BENCH_QUEUE   = "fty-config-bench";
+constexpr auto BENCH_CLIENT  = "fty-config-bench-client";
+// Feature files, below the Augeas root
+constexpr auto ZCONFIG_FILE  = "/bench.cfg";
+constexpr auto NETWORK_FILE  = "/interfaces";
+constexpr auto DEFAULTS_DIR  = "/factory-defaults";
+constexpr auto HISTORY_DIR   = "/history";
+constexpr int  REPLY_TIMEOUT = 600;
+
+/**
+ * In-process stand-in of the message bus: requests are given to the agent listener, replies are kept
+ * until the benchmark picks them up.
+ */
+class InProcessMessageBus : public messagebus::MessageBus
+{
+public:
+    struct Channel
+    {
+        std::mutex                     mutex;
+        std::condition_variable        cv;
+        messagebus::MessageListener    listener;
+        std::list<messagebus::Message> replies;
+    };
+
+    explicit InProcessMessageBus(std::shared_ptr<Channel> channel)
+        : m_channel(std::move(channel))
+    {
+    }
+
+    void connect() override
+    {
+    }
+
+    void publish(const std::string&, const messagebus::Message&) override
+    {
+    }
+
+    void subscribe(const std::string&, messagebus::MessageListener) override
+    {
+    }
+
+    void unsubscribe(const std::string&, messagebus::MessageListener) override
+    {
+    }
+
+    void sendRequest(const std::string&, const messagebus::Message&) override
+    {
+        throw messagebus::MessageBusException("Not supported by the in-process message bus");
+    }
+
+    void sendRequest(const std::string&, const messagebus::Message&, messagebus::MessageListener) override
+    {
+        throw messagebus::MessageBusException("Not supported by the in-process message bus");
+    }
+
+    void sendReply(const std::string&, const messagebus::Message& message) override
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_channel->mutex);
+            m_channel->replies.push_back(message);
+        }
+        m_channel->cv.notify_all();
+    }
+
+    void receive(const std::string&, messagebus::MessageListener messageListener) override
+    {
+        std::lock_guard<std::mutex> lock(m_channel->mutex);
+        m_channel->listener = messageListener;
+    }
+
+    messagebus::Message request(const std::string&, const messagebus::Message&, int) override
+    {
+        throw messagebus::MessageBusException("Not supported by the in-process message bus");
+    }
+
+private:
+    std::shared_ptr<Channel> m_channel;
+};
+
+struct Measure
+{
+    std::chrono::nanoseconds duration{0};
+    uint64_t                 allocations = 0;
+    // Resident memory after the operation minus before, in KB
+    long rss = 0;
+};
+
+/**
+ * @return Resident memory of the process, in KB
+ */
+long currentRss()
+{
+    long          pages = 0, resident = 0;
+    std::ifstream statm("/proc/self/statm");
+    statm >> pages >> resident;
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/**
+ * @return Peak resident memory of the process, in KB
+ */
+long peakRss()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/**
+ * Give a generated file its own modification time, one second after the previous file.
+ * Two variants written in the same second have the same size: Augeas, which compares whole seconds, and the
+ * agent cache, bound by the file system timestamp granularity, could otherwise take one for the other.
+ */
+void stampFile(const std::string& fileName)
+{
+    static time_t   next = time(nullptr);
+    struct timespec times[2];
+    times[0].tv_sec  = ++next;
+    times[0].tv_nsec = 0;
+    times[1]         = times[0];
+    if (utimensat(AT_FDCWD, fileName.c_str(), times, 0) != 0) {
+        throw std::runtime_error("Can't stamp " + fileName);
+    }
+}
+
+/**
+ * Send a query to the agent and wait for its response
+ * @param queryMeta Options of the query
+ */
+Measure call(InProcessMessageBus::Channel& channel, const dto::srr::Query& query, dto::srr::Response& response,
+    const messagebus::MetaData& queryMeta = {})
+{
+    static uint64_t     correlationId = 0;
+    messagebus::Message msg;
+    msg.userData() << query;
+    msg.metaData() = queryMeta;
+    msg.metaData()[messagebus::Message::SUBJECT]        = "bench";
+    msg.metaData()[messagebus::Message::FROM]           = BENCH_CLIENT;
+    msg.metaData()[messagebus::Message::REPLY_TO]       = BENCH_CLIENT;
+    msg.metaData()[messagebus::Message::CORRELATION_ID] = std::to_string(++correlationId);
+
+    Measure  measure;
+    long     rss         = currentRss();
+    uint64_t allocations = g_allocations.load();
+    auto     start       = std::chrono::steady_clock::now();
+    channel.listener(msg);
+
+    std::unique_lock<std::mutex> lock(channel.mutex);
+    if (!channel.cv.wait_for(lock, std::chrono::seconds(REPLY_TIMEOUT), [&channel] {
+            return !channel.replies.empty();
+        })) {
+        throw std::runtime_error("No response from the agent");
+    }
+    measure.duration    = std::chrono::steady_clock::now() - start;
+    measure.allocations = g_allocations.load() - allocations;
+    measure.rss         = currentRss() - rss;
+    messagebus::Message reply = std::move(channel.replies.front());
+    channel.replies.pop_front();
+    lock.unlock();
+
+    reply.userData() >> response;
+    return measure;
+}
+
+/**
+ * Zconfig file of about the given number of nodes: sections of 8 values and a sub section of 8 values
+ * @return Number of nodes generated
+ */
+size_t generateZconfig(const std::string& fileName, size_t nodes, int variant)
+{
+    std::ofstream file(fileName, std::ios::trunc);
+    size_t        generated = 0;
+    for (size_t section = 0; generated < nodes; section++) {
+        file << "section_" << section << "\n";
+        for (int key = 0; key < 8; key++) {
+            file << "    key_" << key << " = value_" << section << "_" << key << "_" << variant << "\n";
+        }
+        file << "    sub\n";
+        for (int key = 0; key < 8; key++) {
+            file << "        key_" << key << " = \"sub value " << section << " " << key << " " << variant << "\"\n";
+        }
+        generated += 18;
+    }
+    file.close();
+    stampFile(fileName);
+    return generated;
+}
+
+/**
+ * Interfaces file with the loopback and the given number of static interfaces
+ * @return Number of nodes generated
+ */
+size_t generateInterfaces(const std::string& fileName, size_t ifaces, int variant)
+{
+    std::ofstream file(fileName, std::ios::trunc);
+    file << "auto lo\niface lo inet loopback\n";
+    size_t generated = 5;
+    for (size_t iface = 0; iface < ifaces; iface++) {
+        file << "\nauto eth" << iface << "\n";
+        file << "iface eth" << iface << " inet static\n";
+        file << "    address 10." << variant << "." << iface << ".1\n";
+        file << "    netmask 255.255.255.0\n";
+        file << "    gateway 10." << variant << "." << iface << ".254\n";
+        generated += 8;
+    }
+    file.close();
+    stampFile(fileName);
+    return generated;
+}
+
+/**
+ * Print the mean of the measures of an operation
+ * @param peak Peak RSS at the start of the scenario, in KB
+ * @param bytes Size of the data of the operation, for its throughput
+ */
+void report(const char* scenario, const char* operation, size_t nodes, const std::vector<Measure>& measures,
+    long peak, size_t bytes)
+{
+    Measure total;
+    for (const auto& measure : measures) {
+        total.duration += measure.duration;
+        total.allocations += measure.allocations;
+        total.rss += measure.rss;
+    }
+    double count = double(measures.size());
+    double ns    = double(total.duration.count()) / count;
+    double allocations = double(total.allocations) / count;
+    printf("%-24s %-8s %8zu nodes %8zu KB %12.0f us %8.1f MB/s %8.1f ns/node %10.0f allocs %6.2f allocs/node "
+           "%+8.0f KB RSS %+8ld KB peak\n",
+        scenario, operation, nodes, bytes / 1024, ns / 1000, double(bytes) * 1000 / ns, ns / double(nodes),
+        allocations, allocations / double(nodes), double(total.rss) / count, peakRss() - peak);
+}
+
+/**
+ * Save and restore a feature file in turn
+ * @param compressed Saves accept the zstd compression, the payloads to restore are then compressed
+ */
+void runScenario(const std::string& lensPath, const std::string& root, const std::string& scenario,
+    const std::string& featureName, const std::string& fileName, const std::function<size_t(int)>& generate,
+    int iterations, bool compressed)
+{
+    long peak = peakRss();
+
+    std::map<std::string, std::string> parameters;
+    parameters[AGENT_NAME_KEY]            = AGENT_NAME;
+    parameters[ENDPOINT_KEY]              = DEFAULT_ENDPOINT;
+    parameters[QUEUE_NAME_KEY]            = BENCH_QUEUE;
+    parameters[SAVE_WORKERS_KEY]          = DEFAULT_SAVE_WORKERS;
+    parameters[REQUEST_WORKERS_KEY]       = DEFAULT_REQUEST_WORKERS;
+    parameters[REQUEST_QUEUE_SIZE_KEY]    = DEFAULT_REQUEST_QUEUE;
+    parameters[COMPRESSION_LEVEL_KEY]     = DEFAULT_COMPRESSION_LEVEL;
+    parameters[STATS_FILE_KEY]            = "";
+    parameters[STATS_PERIOD_KEY]          = "0";
+    // The generated files are rewritten on purpose, nothing to notify nor to keep
+    parameters[CHANGE_DEBOUNCE_KEY]       = "0";
+    parameters[CHANGE_STREAM_KEY]         = CHANGE_STREAM_NAME;
+    parameters[HISTORY_PATH_KEY]          = root + HISTORY_DIR;
+    parameters[HISTORY_SIZE_KEY]          = "0";
+    parameters[AUGEAS_ROOT_KEY]           = root;
+    parameters[AUGEAS_LENS_PATH]          = lensPath;
+    parameters[AUGEAS_OPTIONS]            = "AUG_NO_MODL_AUTOLOAD";
+    parameters[FACTORY_DEFAULTS_PATH_KEY] = root + DEFAULTS_DIR;
+    parameters[CONFIG_VERSION_KEY]        = ACTIVE_VERSION;
+
+    config::FeatureRegistry features;
+    features.add(featureName, fileName, featureName == NETWORK ? NETWORK_FEATURE_LENS : DEFAULT_FEATURE_LENS);
+
+    // Two variants of the file: a save always exports a changed file, a restore always writes every value.
+    size_t      nodes = generate(1);
+    struct stat st;
+    if (stat((root + fileName).c_str(), &st) != 0) {
+        throw std::runtime_error("Can't stat " + fileName);
+    }
+    size_t bytes = size_t(st.st_size);
+
+    auto                         channel = std::make_shared<InProcessMessageBus::Channel>();
+    config::ConfigurationManager manager(parameters, features, std::make_unique<InProcessMessageBus>(channel));
+    if (!channel->listener) {
+        throw std::runtime_error("Agent initialization failed");
+    }
+
+    messagebus::MetaData saveMeta;
+    if (compressed) {
+        saveMeta[config::COMPRESSION_META] = config::ZSTD_COMPRESSION;
+    }
+    dto::srr::Query    saveQuery = dto::srr::createSaveQuery({featureName}, "");
+    dto::srr::Response response;
+    call(*channel, saveQuery, response, saveMeta);
+    dto::srr::Feature saved[2];
+    saved[1] = response.save().map_features_data().at(featureName).feature();
+    generate(0);
+
+    std::vector<Measure> saves, restores;
+    for (int i = 0; i < iterations; i++) {
+        int current = i % 2;
+        saves.push_back(call(*channel, saveQuery, response, saveMeta));
+        saved[current] = response.save().map_features_data().at(featureName).feature();
+        if (saved[current].data() == saved[1 - current].data()) {
+            throw std::runtime_error("The save exported the previous variant");
+        }
+
+        // Restore the other variant
+        std::map<dto::srr::FeatureName, dto::srr::Feature> restoreData{{featureName, saved[1 - current]}};
+        restores.push_back(call(*channel, dto::srr::createRestoreQuery(restoreData, ""), response));
+        const auto& status = response.restore().map_features_status().at(featureName);
+        if (status.status() != dto::srr::Status::SUCCESS) {
+            throw std::runtime_error("Restore failed: " + status.error());
+        }
+    }
+    report(scenario.c_str(), "save", nodes, saves, peak, bytes);
+    report(scenario.c_str(), "restore", nodes, restores, peak, bytes);
+    printf("%-24s payload  %8zu KB\n", scenario.c_str(), saved[0].data().size() / 1024);
+}
+
+/**
+ * Document of about the given size once written: sections of duplicated keys, and ifaces
+ * @return Number of nodes generated
+ */
+size_t generateDocument(config::ConfigDocument& document, size_t bytes)
+{
+    size_t generated = 0;
+    size_t written   = 0;
+    for (size_t section = 0; written < bytes; section++) {
+        std::string                    name = "section_" + std::to_string(section);
+        config::ConfigDocument::NodeId node = document.add(config::ConfigDocument::ROOT, name);
+        for (int key = 0; key < 8; key++) {
+            std::string value = "value " + std::to_string(section) + " " + std::to_string(key);
+            document.add(node, "key", value);
+            written += value.size() + 20;
+        }
+        std::string iface = "eth" + std::to_string(section);
+        document.add(config::ConfigDocument::ROOT, "iface", iface);
+        written += name.size() + iface.size() + 24;
+        generated += 10;
+    }
+    return generated;
+}
+
+void runDocumentScenario(const char* scenario, size_t bytes, int iterations)
+{
+    long                   peak = peakRss();
+    config::ConfigDocument document;
+    size_t                 nodes = generateDocument(document, bytes);
+
+    std::vector<Measure> writes, reads;
+    std::string          json;
+    for (int i = 0; i < iterations; i++) {
+        json.clear();
+        json.shrink_to_fit();
+        Measure  measure;
+        long     rss         = currentRss();
+        uint64_t allocations = g_allocations.load();
+        auto     start       = std::chrono::steady_clock::now();
+        document.writeJson(json);
+        measure.duration    = std::chrono::steady_clock::now() - start;
+        measure.allocations = g_allocations.load() - allocations;
+        measure.rss         = currentRss() - rss;
+        writes.push_back(measure);
+
+        size_t                 leaves = 0;
+        config::JsonLeafReader reader;
+        rss         = currentRss();
+        allocations = g_allocations.load();
+        start       = std::chrono::steady_clock::now();
+        reader.read(json, [&leaves](const config::JsonLeafReader&) {
+            leaves++;
+        });
+        measure.duration    = std::chrono::steady_clock::now() - start;
+        measure.allocations = g_allocations.load() - allocations;
+        measure.rss         = currentRss() - rss;
+        reads.push_back(measure);
+        // 8 keys and an iface by section
+        if (leaves != nodes / 10 * 9) {
+            throw std::runtime_error("Document read back with " + std::to_string(leaves) + " leaves");
+        }
+    }
+    report(scenario, "write", nodes, writes, peak, json.size());
+    report(scenario, "read", nodes, reads, peak, json.size());
+}
+
+std::vector<size_t> parseSizes(const char* list)
+{
+    std::vector<size_t> sizes;
+    std::stringstream   ss(list);
+    std::string         size;
+    while (std::getline(ss, size, ',')) {
+        sizes.push_back(std::stoul(size));
+    }
+    return sizes;
+}
+
+int removeEntry(const char* path, const struct stat*, int, struct FTW*)
+{
+    return remove(path);
+}
+
+void usage()
+{
+    puts("fty-config-bench [options]");
+    puts("  -l|--lens-path DIR     fty lenses directory (default /usr/share/fty/lenses/)");
+    puts("  -n|--nodes N[,N...]    zconfig file sizes, in nodes (default 10,1000,100000,300000)");
+    puts("  -i|--ifaces N[,N...]   interfaces file sizes, in ifaces (default 1,10,50,20000)");
+    puts("  -d|--document MB[,MB]  document sizes, in MB (default 1,8,32)");
+    puts("  -c|--count N           iterations of each scenario (default 10)");
+    puts("  -h|--help              this information");
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    std::string         lensPath   = "/usr/share/fty/lenses/";
+    // Up to multi-MB files: about 30 bytes per zconfig node, 115 bytes per iface
+    std::vector<size_t> nodes      = {10, 1000, 100000, 300000};
+    std::vector<size_t> ifaces     = {1, 10, 50, 20000};
+    std::vector<size_t> documents  = {1, 8, 32};
+    int                 iterations = 10;
+
+    for (int argn = 1; argn < argc; argn++) {
+        std::string arg   = argv[argn];
+        const char* param = argn + 1 < argc ? argv[argn + 1] : nullptr;
+        if (arg == "--help" || arg == "-h") {
+            usage();
+            return EXIT_SUCCESS;
+        } else if (param && (arg == "--lens-path" || arg == "-l")) {
+            lensPath = param;
+        } else if (param && (arg == "--nodes" || arg == "-n")) {
+            nodes = parseSizes(param);
+        } else if (param && (arg == "--ifaces" || arg == "-i")) {
+            ifaces = parseSizes(param);
+        } else if (param && (arg == "--document" || arg == "-d")) {
+            documents = parseSizes(param);
+        } else if (param && (arg == "--count" || arg == "-c")) {
+            iterations = std::max(1, std::stoi(param));
+        } else {
+            usage();
+            return EXIT_FAILURE;
+        }
+        ++argn;
+    }
+
+    ftylog_setInstance("fty-config-bench", "");
+
+    // Augeas root of the feature files
+    char workDir[] = "/tmp/fty-config-bench-XXXXXX";
+    if (!mkdtemp(workDir)) {
+        perror("mkdtemp");
+        return EXIT_FAILURE;
+    }
+
+    int result = EXIT_SUCCESS;
+    try {
+        // Plain payloads, then compressed ones
+        for (bool compressed : {false, true}) {
+            const char* suffix = compressed ? "-zstd" : "";
+            for (size_t size : nodes) {
+                runScenario(lensPath, workDir, "zconfig-" + std::to_string(size) + suffix, MONITORING_FEATURE_NAME,
+                    ZCONFIG_FILE,
+                    [&](int variant) {
+                        return generateZconfig(workDir + std::string(ZCONFIG_FILE), size, variant);
+                    },
+                    iterations, compressed);
+            }
+            for (size_t size : ifaces) {
+                runScenario(lensPath, workDir, "interfaces-" + std::to_string(size) + suffix, NETWORK, NETWORK_FILE,
+                    [&](int variant) {
+                        return generateInterfaces(workDir + std::string(NETWORK_FILE), size, variant);
+                    },
+                    iterations, compressed);
+            }
+        }
+        for (size_t size : documents) {
+            std::string scenario = "document-" + std::to_string(size) + "MB";
+            runDocumentScenario(scenario.c_str(), size << 20, iterations);
+        }
+    } catch (std::exception& ex) {
+        fprintf(stderr, "Benchmark failed: %s\n", ex.what());
+        result = EXIT_FAILURE;
+    }
+
+    nftw(workDir, removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+    return result;
+}
@@ -30,6 +30,7 @@
 #include <map>
 #include <mutex>
 #include <sstream>
+#include <vector>
 
 // functions
 
@@ -65,6 +66,29 @@ static void setSignalHandler()
     exit(EXIT_FAILURE);
 }
 
+/**
+ * Report the result of an offline save or restore
+ * @return Exit code, failure if any feature failed
+ */
+static int reportOffline(const std::map<dto::srr::FeatureName, dto::srr::FeatureStatus>& mapStatus,
+    const messagebus::MetaData& replyMeta)
+{
+    int result = EXIT_SUCCESS;
+    for (const auto& item : mapStatus) {
+        if (item.second.status() != dto::srr::Status::SUCCESS) {
+            fprintf(stderr, "%s: %s\n", item.first.c_str(), item.second.error().c_str());
+            result = EXIT_FAILURE;
+        }
+    }
+    // Changes of a dry run, one line per feature
+    for (const auto& item : replyMeta) {
+        if (item.first.compare(0, strlen(config::FEATURE_DIFF_META), config::FEATURE_DIFF_META) == 0) {
+            printf("%s: %s\n", item.first.c_str() + strlen(config::FEATURE_DIFF_META), item.second.c_str());
+        }
+    }
+    return result;
+}
+
 int main(int argc, char* argv[])
 {
     using Parameters = std::map<std::string, std::string>;
@@ -80,6 +104,13 @@ int main(int argc, char* argv[])
     int   argn;
     char* config_file = nullptr;
     bool  verbose     = false;
+    // Offline save or restore
+    bool                     save         = false;
+    std::vector<std::string> saveFeatures;
+    char*                    output_file  = nullptr;
+    char*                    restore_file = nullptr;
+    bool                     dryRun       = false;
+    bool                     capture      = false;
     // Parse command line
     for (argn = 1; argn < argc; argn++) {
         char* param = nullptr;
@@ -95,24 +126,61 @@ int main(int argc, char* argv[])
             if (param)
                 config_file = param;
             ++argn;
+        } else if (strcmp(argv[argn], "--save") == 0 || strcmp(argv[argn], "-s") == 0) {
+            save = true;
+            // Features up to the next option, all of them if none
+            while (argn < argc - 1 && argv[argn + 1][0] != '-') {
+                saveFeatures.push_back(argv[++argn]);
+            }
+        } else if (strcmp(argv[argn], "--output") == 0 || strcmp(argv[argn], "-o") == 0) {
+            if (param)
+                output_file = param;
+            ++argn;
+        } else if (strcmp(argv[argn], "--restore") == 0 || strcmp(argv[argn], "-r") == 0) {
+            if (param)
+                restore_file = param;
+            ++argn;
+        } else if (strcmp(argv[argn], "--dry-run") == 0 || strcmp(argv[argn], "-n") == 0) {
+            dryRun = true;
+        } else if (strcmp(argv[argn], "--capture-defaults") == 0) {
+            capture = true;
         }
     }
+    if ((save && (!output_file || restore_file)) || (dryRun && !restore_file) || (capture && (save || restore_file))) {
+        usage();
+        return EXIT_FAILURE;
+    }
 
     // Default configuration.
-    paramsConfig[ENDPOINT_KEY]   = DEFAULT_ENDPOINT;
-    paramsConfig[AGENT_NAME_KEY] = AGENT_NAME;
-    paramsConfig[QUEUE_NAME_KEY] = MSG_QUEUE_NAME;
-    // Default configuration files path.
-    paramsConfig[MONITORING_FEATURE_NAME]   = "/etc/fty-nut/fty-nut.cfg";
-    paramsConfig[NOTIFICATION_FEATURE_NAME] = "/etc/fty-email/fty-email.cfg";
-    paramsConfig[AUTOMATION_SETTINGS]       = "/etc/fty/etn-automation.cfg";
-    paramsConfig[USER_SESSION_FEATURE_NAME] = "/etc/fty/fty-session.cfg";
-    paramsConfig[DISCOVERY]                 = "/etc/fty-discovery/fty-discovery.cfg";
-    paramsConfig[NETWORK]                   = "/etc/network/interfaces";
-    paramsConfig[MASS_MANAGEMENT]           = "/var/lib/fty/etn-mass-management/settings.cfg";
+    paramsConfig[ENDPOINT_KEY]           = DEFAULT_ENDPOINT;
+    paramsConfig[AGENT_NAME_KEY]         = AGENT_NAME;
+    paramsConfig[QUEUE_NAME_KEY]         = MSG_QUEUE_NAME;
+    paramsConfig[SAVE_WORKERS_KEY]       = DEFAULT_SAVE_WORKERS;
+    paramsConfig[REQUEST_WORKERS_KEY]    = DEFAULT_REQUEST_WORKERS;
+    paramsConfig[REQUEST_QUEUE_SIZE_KEY] = DEFAULT_REQUEST_QUEUE;
+    paramsConfig[COMPRESSION_LEVEL_KEY]  = DEFAULT_COMPRESSION_LEVEL;
+    paramsConfig[STATS_FILE_KEY]         = DEFAULT_STATS_FILE;
+    paramsConfig[STATS_PERIOD_KEY]       = DEFAULT_STATS_PERIOD;
+    paramsConfig[CHANGE_DEBOUNCE_KEY]    = DEFAULT_CHANGE_DEBOUNCE;
+    paramsConfig[CHANGE_STREAM_KEY]      = CHANGE_STREAM_NAME;
+    // Default features.
+    config::FeatureRegistry features;
+    features.add(MONITORING_FEATURE_NAME, "/etc/fty-nut/fty-nut.cfg", DEFAULT_FEATURE_LENS);
+    features.add(NOTIFICATION_FEATURE_NAME, "/etc/fty-email/fty-email.cfg", DEFAULT_FEATURE_LENS);
+    features.add(AUTOMATION_SETTINGS, "/etc/fty/etn-automation.cfg", DEFAULT_FEATURE_LENS);
+    features.add(USER_SESSION_FEATURE_NAME, "/etc/fty/fty-session.cfg", DEFAULT_FEATURE_LENS);
+    features.add(DISCOVERY, "/etc/fty-discovery/fty-discovery.cfg", DEFAULT_FEATURE_LENS);
+    features.add(NETWORK, "/etc/network/interfaces", NETWORK_FEATURE_LENS);
+    features.add(MASS_MANAGEMENT, "/var/lib/fty/etn-mass-management/settings.cfg", DEFAULT_FEATURE_LENS);
     // Default augeas configuration.
+    paramsConfig[AUGEAS_ROOT_KEY]  = DEFAULT_AUGEAS_ROOT;
     paramsConfig[AUGEAS_LENS_PATH] = "/usr/share/fty/lenses/";
     paramsConfig[AUGEAS_OPTIONS]   = AUG_NONE;
+    // Default factory defaults store.
+    paramsConfig[FACTORY_DEFAULTS_PATH_KEY] = DEFAULT_FACTORY_DEFAULTS;
+    // Default snapshot history.
+    paramsConfig[HISTORY_PATH_KEY] = DEFAULT_HISTORY_PATH;
+    paramsConfig[HISTORY_SIZE_KEY] = DEFAULT_HISTORY_SIZE;
     // version
     paramsConfig[CONFIG_VERSION_KEY] = ACTIVE_VERSION;
 
@@ -121,20 +189,29 @@ int main(int argc, char* argv[])
         mlm::ZConfig config(config_file);
         // verbose mode
         std::istringstream(config.getEntry("server/verbose", "0")) >> verbose;
+        paramsConfig[SAVE_WORKERS_KEY]       = config.getEntry("server/saveWorkers", DEFAULT_SAVE_WORKERS);
+        paramsConfig[REQUEST_WORKERS_KEY]    = config.getEntry("server/requestWorkers", DEFAULT_REQUEST_WORKERS);
+        paramsConfig[REQUEST_QUEUE_SIZE_KEY] = config.getEntry("server/requestQueueSize", DEFAULT_REQUEST_QUEUE);
+        paramsConfig[COMPRESSION_LEVEL_KEY]  = config.getEntry("server/compressionLevel", DEFAULT_COMPRESSION_LEVEL);
+        paramsConfig[STATS_FILE_KEY]         = config.getEntry("server/statsFile", DEFAULT_STATS_FILE);
+        paramsConfig[STATS_PERIOD_KEY]       = config.getEntry("server/statsPeriod", DEFAULT_STATS_PERIOD);
+        paramsConfig[CHANGE_DEBOUNCE_KEY]    = config.getEntry("server/changeDebounce", DEFAULT_CHANGE_DEBOUNCE);
         // Message bus configuration.
-        paramsConfig[ENDPOINT_KEY]   = config.getEntry("srr-msg-bus/endpoint", DEFAULT_ENDPOINT);
-        paramsConfig[QUEUE_NAME_KEY] = config.getEntry("srr-msg-bus/queueName", MSG_QUEUE_NAME);
-        // Configuration file path
-        paramsConfig[MONITORING_FEATURE_NAME]   = config.getEntry("available-features/monitoring", "");
-        paramsConfig[NOTIFICATION_FEATURE_NAME] = config.getEntry("available-features/notification", "");
-        paramsConfig[AUTOMATION_SETTINGS]       = config.getEntry("available-features/automation-settings", "");
-        paramsConfig[USER_SESSION_FEATURE_NAME] = config.getEntry("available-features/user-session", "");
-        paramsConfig[DISCOVERY]                 = config.getEntry("available-features/discovery", "");
-        paramsConfig[NETWORK]                   = config.getEntry("available-features/network", "");
-        paramsConfig[MASS_MANAGEMENT]           = config.getEntry("available-features/etn-mass-management", "");
+        paramsConfig[ENDPOINT_KEY]      = config.getEntry("srr-msg-bus/endpoint", DEFAULT_ENDPOINT);
+        paramsConfig[QUEUE_NAME_KEY]    = config.getEntry("srr-msg-bus/queueName", MSG_QUEUE_NAME);
+        paramsConfig[CHANGE_STREAM_KEY] = config.getEntry("srr-msg-bus/changeStream", CHANGE_STREAM_NAME);
+        // Features, any number of them
+        features.load(config_file);
         // Augeas configuration
+        paramsConfig[AUGEAS_ROOT_KEY]  = config.getEntry("augeas/root", DEFAULT_AUGEAS_ROOT);
         paramsConfig[AUGEAS_LENS_PATH] = config.getEntry("augeas/lensPath", "/usr/share/fty/lenses/");
         paramsConfig[AUGEAS_OPTIONS]   = config.getEntry("augeas/augeasOptions", "0");
+        // Factory defaults store
+        paramsConfig[FACTORY_DEFAULTS_PATH_KEY] =
+            config.getEntry("reset/factoryDefaultsPath", DEFAULT_FACTORY_DEFAULTS);
+        // Snapshot history
+        paramsConfig[HISTORY_PATH_KEY] = config.getEntry("history/path", DEFAULT_HISTORY_PATH);
+        paramsConfig[HISTORY_SIZE_KEY] = config.getEntry("history/snapshots", DEFAULT_HISTORY_SIZE);
         // version
         paramsConfig[CONFIG_VERSION_KEY] = config.getEntry("config/version", ACTIVE_VERSION);
     }
@@ -144,10 +221,40 @@ int main(int argc, char* argv[])
         log_trace("Verbose mode OK");
     }
 
+    // Offline save, restore or factory defaults capture, e.g. at early boot: the engines run in process, without the
+    // message bus.
+    if (save || restore_file || capture) {
+        // The snapshot history belongs to the agent, which may be running.
+        paramsConfig[HISTORY_SIZE_KEY] = "0";
+        std::map<dto::srr::FeatureName, dto::srr::FeatureStatus> mapStatus;
+        messagebus::MetaData                                     replyMeta;
+        try {
+            config::ConfigurationManager configManager(paramsConfig, features, config::ConfigurationManager::Offline());
+            if (capture) {
+                // Only the features without factory defaults, a capture is never redone.
+                for (const auto& featureName : configManager.captureFactoryDefaults()) {
+                    printf("%s: factory defaults captured\n", featureName.c_str());
+                }
+            } else if (save) {
+                mapStatus = configManager.saveToFile(saveFeatures, output_file);
+            } else {
+                messagebus::MetaData queryMeta;
+                if (dryRun) {
+                    queryMeta[config::DRY_RUN_META] = "true";
+                }
+                mapStatus = configManager.restoreFromFile(restore_file, queryMeta, replyMeta);
+            }
+        } catch (std::exception& ex) {
+            fprintf(stderr, "%s failed: %s\n", capture ? "Capture" : save ? "Save" : "Restore", ex.what());
+            return EXIT_FAILURE;
+        }
+        return reportOffline(mapStatus, replyMeta);
+    }
+
     log_info((AGENT_NAME + std::string(" starting")).c_str());
 
     // Start config agent
-    config::ConfigurationManager configManager(paramsConfig);
+    config::ConfigurationManager configManager(paramsConfig, features);
 
     // wait until interrupt
     std::unique_lock<std::mutex> lock(g_cvMutex);
@@ -167,4 +274,10 @@ void usage()
     puts("  -v|--verbose        verbose test output");
     puts("  -h|--help           this information");
     puts("  -c|--config         path to config file");
+    puts("Offline save and restore, without the message bus:");
+    puts("  -s|--save [FEATURE...] -o|--output FILE");
+    puts("                      save the features (all if none) in FILE");
+    puts("  -r|--restore FILE   restore all the features of FILE, all or nothing");
+    puts("  -n|--dry-run        with --restore, only print the changes");
+    puts("  --capture-defaults  capture the factory defaults of the features without one, at first boot");
 }
@@ -27,9 +27,27 @@ constexpr auto AGENT_NAME                = "fty-config";
 constexpr auto ENDPOINT_KEY              = "endPoint";
 constexpr auto DEFAULT_ENDPOINT          = "ipc://@/malamute";
 constexpr auto CONFIG_DEFAULT_LOG_CONFIG = "/etc/fty/ftylog.cfg";
+constexpr auto SAVE_WORKERS_KEY          = "saveWorkers";
+constexpr auto DEFAULT_SAVE_WORKERS      = "0";
+constexpr auto REQUEST_WORKERS_KEY       = "requestWorkers";
+constexpr auto DEFAULT_REQUEST_WORKERS   = "4";
+constexpr auto REQUEST_QUEUE_SIZE_KEY    = "requestQueueSize";
+constexpr auto DEFAULT_REQUEST_QUEUE     = "16";
+constexpr auto COMPRESSION_LEVEL_KEY     = "compressionLevel";
+constexpr auto DEFAULT_COMPRESSION_LEVEL = "3";
+constexpr auto STATS_FILE_KEY            = "statsFile";
+constexpr auto DEFAULT_STATS_FILE        = "/var/lib/fty/fty-config/stats.json";
+constexpr auto STATS_PERIOD_KEY          = "statsPeriod";
+constexpr auto DEFAULT_STATS_PERIOD      = "60";
+constexpr auto CHANGE_DEBOUNCE_KEY       = "changeDebounce";
+constexpr auto DEFAULT_CHANGE_DEBOUNCE   = "500";
 // Queue definition
 constexpr auto QUEUE_NAME_KEY            = "queueName";
 constexpr auto MSG_QUEUE_NAME            = "ETN.Q.IPMCORE.CONFIG";
+// Stream definition
+constexpr auto CHANGE_STREAM_KEY         = "changeStream";
+constexpr auto CHANGE_STREAM_NAME        = "ETN.S.IPMCORE.CONFIG";
+constexpr auto CHANGE_SUBJECT            = "CONFIGURATION_CHANGED";
 // Features definition
 constexpr auto MONITORING_FEATURE_NAME   = "monitoring";
 constexpr auto NOTIFICATION_FEATURE_NAME = "notification";
@@ -40,8 +58,21 @@ constexpr auto MASS_MANAGEMENT           = "etn-mass-management";
 constexpr auto NETWORK                   = "network";
 
 // Augeas definition
+constexpr auto AUGEAS_ROOT_KEY           = "augeasRoot";
+constexpr auto DEFAULT_AUGEAS_ROOT       = "/";
 constexpr auto AUGEAS_LENS_PATH          = "AugeasLensPath";
 constexpr auto AUGEAS_OPTIONS            = "augeasOptions";
+// Lens of the features
+constexpr auto DEFAULT_FEATURE_LENS      = "Zconfig.lns";
+constexpr auto NETWORK_FEATURE_LENS      = "Interfaces.lns";
+// Reset definition
+constexpr auto FACTORY_DEFAULTS_PATH_KEY = "factoryDefaultsPath";
+constexpr auto DEFAULT_FACTORY_DEFAULTS  = "/var/lib/fty/fty-config/factory-defaults";
+// History definition
+constexpr auto HISTORY_PATH_KEY          = "historyPath";
+constexpr auto DEFAULT_HISTORY_PATH      = "/var/lib/fty/fty-config/history";
+constexpr auto HISTORY_SIZE_KEY          = "historySize";
+constexpr auto DEFAULT_HISTORY_SIZE      = "20";
 // Properties definition
 constexpr auto CONFIG_VERSION_KEY        = "version";
 constexpr auto ACTIVE_VERSION            = "1.0";
@@ -0,0 +1,133 @@
+/*  =========================================================================
+    fty_config_augeas - Fty config augeas handle
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+ */
+
+/*
+@header
+    fty_config_augeas - Fty config augeas handle
+@discuss
+    Augeas is initialized without loading any file. The include patterns declared by the
+    lenses are recorded once, then each load restricts the transforms to the files requested.
+@end
+ */
+
+#include "fty_config_augeas.h"
+#include "fty_config_exception.h"
+#include <algorithm>
+#include <fnmatch.h>
+#include <fty_log.h>
+
+namespace config {
+
+#define FILE_SEPARATOR "/"
+#define AUGEAS_FILES   FILE_SEPARATOR "files"
+#define AUGEAS_LOAD    FILE_SEPARATOR "augeas" FILE_SEPARATOR "load"
+#define ANY_NODES      FILE_SEPARATOR "*"
+#define AUGEAS_INCL    FILE_SEPARATOR "incl"
+
+AugeasHandle::AugeasHandle(
+    const std::string& root, const std::string& lensPath, unsigned int flags, const FileLenses& fileLenses)
+    : m_aug(aug_init(root.c_str(), lensPath.c_str(), flags | AUG_NO_LOAD), aug_close)
+    , m_root(root)
+{
+    if (!m_aug) {
+        throw ConfigurationException("Augeas tool initialization failed");
+    }
+    if (flags & AUG_NO_MODL_AUTOLOAD) {
+        initTransforms(fileLenses);
+    }
+    initLoadFilters();
+}
+
+std::string AugeasHandle::systemPath(const std::string& root, const std::string& fileName)
+{
+    // The file names are absolute: "/" is no prefix, a trailing separator is dropped.
+    return root.substr(0, root.find_last_not_of(FILE_SEPARATOR) + 1) + fileName;
+}
+
+void AugeasHandle::initTransforms(const FileLenses& fileLenses)
+{
+    // No lens was autoloaded: declare a transform for each feature file, Augeas then compiles
+    // the modules of these lenses (and their dependencies) on the first load only.
+    for (const auto& fileLens : fileLenses) {
+        if (aug_transform(m_aug.get(), fileLens.second.c_str(), fileLens.first.c_str(), 0) != 0) {
+            log_error("Augeas transform of %s with %s failed: %s", fileLens.first.c_str(), fileLens.second.c_str(),
+                aug_error_message(m_aug.get()));
+        }
+    }
+}
+
+void AugeasHandle::initLoadFilters()
+{
+    // Keep the include patterns declared by every (auto)loaded lens, they are used to
+    // route each feature file to the transform able to parse it.
+    char** matches;
+    int    nmatches = aug_match(m_aug.get(), AUGEAS_LOAD ANY_NODES AUGEAS_INCL, &matches);
+    for (int i = 0; i < nmatches; i++) {
+        std::string incl = matches[i];
+        const char* pattern;
+        if (aug_get(m_aug.get(), matches[i], &pattern) == 1 && pattern) {
+            m_loadFilters[incl.substr(0, incl.rfind(FILE_SEPARATOR))].push_back(pattern);
+        }
+        free(matches[i]);
+    }
+    if (nmatches >= 0) {
+        free(matches);
+    }
+    log_debug("Augeas load filters: %zu transforms", m_loadFilters.size());
+}
+
+void AugeasHandle::load(const std::set<std::string>& requestedFiles, bool reparse)
+{
+    if (reparse) {
+        for (const auto& file : requestedFiles) {
+            aug_rm(m_aug.get(), (AUGEAS_FILES + file).c_str());
+        }
+    }
+    // Files already loaded stay in the tree, so that a later load only re-parses them if they changed.
+    if (!std::includes(
+            m_loadedFiles.begin(), m_loadedFiles.end(), requestedFiles.begin(), requestedFiles.end())) {
+        std::set<std::string> files = requestedFiles;
+        files.insert(m_loadedFiles.begin(), m_loadedFiles.end());
+        // Restrict every transform to the requested files it can handle.
+        for (const auto& filter : m_loadFilters) {
+            aug_rm(m_aug.get(), (filter.first + AUGEAS_INCL).c_str());
+            for (const auto& file : files) {
+                for (const auto& pattern : filter.second) {
+                    if (fnmatch(pattern.c_str(), file.c_str(), FNM_PATHNAME) == 0) {
+                        aug_set(m_aug.get(), (filter.first + AUGEAS_INCL "[last()+1]").c_str(), file.c_str());
+                        break;
+                    }
+                }
+            }
+        }
+        m_loadedFiles = std::move(files);
+    }
+    // Augeas only re-parses the files modified since the previous load.
+    aug_load(m_aug.get());
+}
+
+void AugeasHandle::reload()
+{
+    // Files whose tree was modified are parsed again, whatever their modification time.
+    aug_load(m_aug.get());
+}
+
+} // namespace config
@@ -0,0 +1,98 @@
+/*  =========================================================================
+    fty_config_augeas - Fty config augeas handle
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+
+#include <augeas.h>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace config {
+
+// Configuration file full path -> Augeas lens parsing it (e.g. "Zconfig.lns")
+using FileLenses = std::map<std::string, std::string>;
+
+/**
+ * Augeas handle loading on demand only the configuration files it is asked for.
+ * An handle is not thread safe, use one per thread.
+ */
+class AugeasHandle
+{
+public:
+    /**
+     * @param root File system root of the configuration files
+     * @param lensPath Augeas lens path
+     * @param flags Augeas flags, AUG_NO_LOAD is always added
+     * @param fileLenses Lenses of the configuration files. Only used with AUG_NO_MODL_AUTOLOAD: the handle then
+     * compiles these lenses only, instead of every lens found in the search path.
+     * @throw ConfigurationException on initialization failure
+     */
+    AugeasHandle(
+        const std::string& root, const std::string& lensPath, unsigned int flags, const FileLenses& fileLenses = {});
+
+    augeas* get() const
+    {
+        return m_aug.get();
+    }
+
+    /**
+     * @return Path of a configuration file in the file system, below the root
+     */
+    std::string systemPath(const std::string& fileName) const
+    {
+        return systemPath(m_root, fileName);
+    }
+    /**
+     * @param root File system root, as given to the constructor
+     * @return Path of a configuration file in the file system, below this root
+     */
+    static std::string systemPath(const std::string& root, const std::string& fileName);
+
+    /**
+     * Load (or refresh) files in the tree. Files loaded before are kept: Augeas only re-parses them if they changed.
+     * @param files Configuration files full path
+     * @param reparse Drop the trees of the files first, so that they are parsed again. Augeas compares whole second
+     * modification times: a file rewritten in the second of its previous load is otherwise not read again.
+     */
+    void load(const std::set<std::string>& files, bool reparse = false);
+
+    /**
+     * Reload the files of the tree, dropping its pending changes
+     */
+    void reload();
+
+private:
+    using AugeasSmartPtr = std::unique_ptr<augeas, decltype(&aug_close)>;
+    AugeasSmartPtr m_aug;
+    // Root without its trailing separator
+    std::string m_root;
+    // Augeas transform path -> include patterns, as declared by the lenses
+    std::map<std::string, std::vector<std::string>> m_loadFilters;
+    std::set<std::string>                           m_loadedFiles;
+
+    void initTransforms(const FileLenses& fileLenses);
+    void initLoadFilters();
+};
+
+} // namespace config
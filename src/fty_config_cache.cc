@@ -0,0 +1,97 @@
+/*  =========================================================================
+    fty_config_cache - Fty config feature cache
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+ */
+
+/*
+@header
+    fty_config_cache - Fty config feature cache
+@discuss
+    Keep the serialized features between requests. An entry is served as long as the
+    configuration file keeps the same device, inode, size and modification time.
+    The content hash of the data is kept along, so an unchanged feature is not hashed again.
+@end
+ */
+
+#include "fty_config_cache.h"
+#include <cinttypes>
+#include <cstdio>
+
+namespace config {
+
+std::string contentHash(std::string_view data)
+{
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016" PRIx64, fnv1a64(data));
+    return std::string(CONTENT_HASH_PREFIX) + hex;
+}
+
+FileStamp::FileStamp(const std::string& fileName)
+{
+    struct stat st;
+    if (stat(fileName.c_str(), &st) == 0) {
+        valid  = true;
+        device = st.st_dev;
+        inode  = st.st_ino;
+        size   = st.st_size;
+        mtime  = st.st_mtim;
+    }
+}
+
+bool FileStamp::operator==(const FileStamp& other) const
+{
+    return valid && other.valid && device == other.device && inode == other.inode && size == other.size &&
+           mtime.tv_sec == other.mtime.tv_sec && mtime.tv_nsec == other.mtime.tv_nsec;
+}
+
+bool FeatureCache::get(
+    const std::string& featureName, const FileStamp& stamp, std::string& data, std::string& hash) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(featureName);
+    if (it == m_entries.end() || it->second.stamp != stamp) {
+        return false;
+    }
+    data = it->second.data;
+    hash = it->second.hash;
+    return true;
+}
+
+void FeatureCache::put(
+    const std::string& featureName, const FileStamp& stamp, const std::string& data, const std::string& hash)
+{
+    if (!stamp.valid) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto                        it = m_entries.find(featureName);
+    if (it == m_entries.end()) {
+        m_entries.emplace(featureName, Entry{stamp, data, hash});
+    } else {
+        it->second = Entry{stamp, data, hash};
+    }
+}
+
+void FeatureCache::invalidate(const std::string& featureName)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.erase(featureName);
+}
+
+} // namespace config
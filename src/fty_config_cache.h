@@ -0,0 +1,94 @@
+/*  =========================================================================
+    fty_config_cache - Fty config feature cache
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+
+#include "fty_config_hash.h"
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+
+namespace config {
+
+// Content hashes are prefixed by their algorithm
+constexpr auto CONTENT_HASH_PREFIX = "fnv1a64:";
+
+/**
+ * Compute the content hash of a serialized feature
+ * @param data Serialized feature
+ * @return Hash, as "fnv1a64:" and 16 hexadecimal digits
+ */
+std::string contentHash(std::string_view data);
+
+/**
+ * Identity of a configuration file at a given time (device, inode, size and modification time)
+ */
+struct FileStamp
+{
+    explicit FileStamp(const std::string& fileName);
+
+    bool operator==(const FileStamp& other) const;
+    bool operator!=(const FileStamp& other) const
+    {
+        return !(*this == other);
+    }
+
+    bool            valid = false;
+    dev_t           device{};
+    ino_t           inode{};
+    off_t           size{};
+    struct timespec mtime{};
+};
+
+/**
+ * Cache of the serialized features, each entry is valid as long as its configuration file is unchanged.
+ * The cache is thread safe.
+ */
+class FeatureCache
+{
+public:
+    /**
+     * Get the cached data of a feature
+     * @param featureName Feature name
+     * @param stamp Current stamp of the feature configuration file
+     * @param data Cached data, set only on hit
+     * @param hash Content hash of the cached data, set only on hit
+     * @return true on hit
+     */
+    bool get(const std::string& featureName, const FileStamp& stamp, std::string& data, std::string& hash) const;
+    void put(const std::string& featureName, const FileStamp& stamp, const std::string& data, const std::string& hash);
+    void invalidate(const std::string& featureName);
+
+private:
+    struct Entry
+    {
+        FileStamp   stamp;
+        std::string data;
+        std::string hash;
+    };
+    mutable std::mutex           m_mutex;
+    std::map<std::string, Entry> m_entries;
+};
+
+} // namespace config
@@ -0,0 +1,269 @@
+/*  =========================================================================
+    fty_config_change_notifier - Fty config change notifier
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+ */
+
+/*
+@header
+    fty_config_change_notifier - Fty config change notifier
+@discuss
+    The trees are flat sorted arrays of the leaves, so the delta of a feature is a single
+    merge of the paths. The leaves of an entry (e.g. an iface) are keyed by its value rather
+    than its position, so an inserted entry only adds its own leaves. A tree costs two
+    allocations whatever its size, which matters as the trees of all the features are kept
+    for the agent lifetime. A file rewritten with the same values publishes nothing.
+@end
+ */
+
+#include "fty_config_change_notifier.h"
+#include "fty_config_document.h"
+#include <algorithm>
+#include <augeas.h>
+#include <cstring>
+#include <fty_common.h>
+#include <fty_log.h>
+#include <cstdlib>
+#include <future>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace config {
+
+#define FILE_SEPARATOR     "/"
+#define DESCENDANT_NODES   FILE_SEPARATOR "descendant::*"
+#define COMMENTS_DELIMITER "#"
+#define POSITION_START     '['
+#define POSITION_END       ']'
+#define CHANGE_NODES_VAR   "fty_config_change"
+
+ChangeNotifier::ChangeNotifier(const FeatureRegistry& features, AugeasWorkerPool& pool,
+    std::chrono::milliseconds debounce, Publisher publisher)
+    : m_features(features)
+    , m_pool(pool)
+    , m_publisher(std::move(publisher))
+{
+    std::set<std::string> featureNames, files;
+    for (const auto& item : m_features.features()) {
+        featureNames.insert(item.first);
+        files.insert(m_pool.systemPath(item.second.fileName));
+    }
+    readTrees(featureNames, m_trees);
+    m_watcher = std::make_unique<FileWatcher>(files, debounce, [this](const std::set<std::string>& changed) {
+        onChange(changed);
+    });
+}
+
+ChangeNotifier::~ChangeNotifier()
+{
+    // No change is processed after this point.
+    m_watcher.reset();
+}
+
+void ChangeNotifier::onChange(const std::set<std::string>& files)
+{
+    std::set<std::string> featureNames;
+    for (const auto& item : m_features.features()) {
+        if (files.count(m_pool.systemPath(item.second.fileName))) {
+            featureNames.insert(item.first);
+        }
+    }
+    std::map<std::string, Tree> trees;
+    readTrees(featureNames, trees);
+
+    for (auto& item : trees) {
+        const std::string& featureName = item.first;
+        Tree&              previous    = m_trees[featureName];
+        std::string        delta       = getDelta(featureName, previous, item.second);
+        previous                       = std::move(item.second);
+        if (!delta.empty()) {
+            log_debug("Configuration of %s changed", featureName.c_str());
+            m_publisher(featureName, delta);
+        }
+    }
+}
+
+void ChangeNotifier::readTrees(const std::set<std::string>& featureNames, std::map<std::string, Tree>& trees)
+{
+    // One feature per worker
+    std::vector<std::future<void>> reads;
+    for (const auto& featureName : featureNames) {
+        const FeatureDefinition& feature = *m_features.find(featureName);
+        Tree&                    tree    = trees[featureName];
+        reads.push_back(m_pool.post([&feature, &tree](AugeasHandle& aug) {
+            readTree(aug, feature, tree);
+        }));
+    }
+    for (auto& read : reads) {
+        read.wait();
+    }
+    for (auto& read : reads) {
+        read.get();
+    }
+}
+
+void ChangeNotifier::readTree(AugeasHandle& aug, const FeatureDefinition& feature, Tree& tree)
+{
+    // Parsed again, even rewritten in the same second as the previous load
+    aug.load({feature.fileName}, true);
+
+    // All the nodes first: the path of a leaf depends on the values of its ancestors, and on their siblings.
+    struct Node
+    {
+        std::string path;
+        std::string value;
+        bool        hasValue;
+    };
+    std::vector<Node>               nodes;
+    std::unordered_set<std::string> parents;
+    int nmatches = aug_defvar(aug.get(), CHANGE_NODES_VAR, (feature.augeasPath + DESCENDANT_NODES).c_str());
+    for (int i = 0; i < nmatches; i++) {
+        const char* value = nullptr;
+        char*       match = nullptr;
+        if (aug_ns_attr(aug.get(), CHANGE_NODES_VAR, i, &value, nullptr, nullptr) < 0 ||
+            aug_ns_path(aug.get(), CHANGE_NODES_VAR, i, &match) < 0 || !match) {
+            continue;
+        }
+        std::unique_ptr<char, decltype(&free)> owner(match, free);
+        // Skip all comments (and their descendants)
+        std::string_view path(match + feature.augeasPath.size() + 1);
+        if (path.find(COMMENTS_DELIMITER) == std::string_view::npos) {
+            nodes.push_back(Node{std::string(path), value ? value : "", value != nullptr});
+            size_t parent = parentEnd(path);
+            if (parent != std::string_view::npos) {
+                parents.emplace(path.substr(0, parent));
+            }
+        }
+    }
+    aug_defvar(aug.get(), CHANGE_NODES_VAR, nullptr);
+
+    // An entry (a node with a value and children, e.g. an iface) is named after its value when no sibling of the
+    // same label shares it: inserting an entry does not shift the path of the next ones.
+    std::unordered_map<std::string, size_t> entryValues;
+    for (const auto& node : nodes) {
+        if (node.hasValue && parents.count(node.path)) {
+            entryValues[entryKey(node.path, node.value)]++;
+        }
+    }
+    std::unordered_map<std::string, std::string> keyedPaths;
+    for (const auto& node : nodes) {
+        size_t           parent  = parentEnd(node.path);
+        std::string_view segment = node.path;
+        std::string      keyed;
+        if (parent != std::string::npos) {
+            keyed   = keyedPaths[node.path.substr(0, parent)] + FILE_SEPARATOR;
+            segment = segment.substr(parent + 1);
+        }
+        if (node.hasValue && parents.count(node.path) && entryValues[entryKey(node.path, node.value)] == 1 &&
+            node.value.find_first_of("\\\"\n") == std::string::npos) {
+            keyed.append(segment.substr(0, segment.find(POSITION_START))).append("[.=\"").append(node.value) += "\"]";
+        } else {
+            keyed.append(segment);
+        }
+        if (node.hasValue) {
+            Tree::Leaf leaf;
+            leaf.path      = static_cast<uint32_t>(tree.text.size());
+            leaf.pathSize  = static_cast<uint32_t>(keyed.size());
+            leaf.value     = leaf.path + leaf.pathSize;
+            leaf.valueSize = static_cast<uint32_t>(node.value.size());
+            tree.text.append(keyed).append(node.value);
+            tree.leaves.push_back(leaf);
+        }
+        if (parents.count(node.path)) {
+            keyedPaths.emplace(node.path, std::move(keyed));
+        }
+    }
+
+    // Augeas paths are unique, the document order is not the path order.
+    std::sort(tree.leaves.begin(), tree.leaves.end(), [&tree](const Tree::Leaf& a, const Tree::Leaf& b) {
+        return tree.path(a) < tree.path(b);
+    });
+    tree.text.shrink_to_fit();
+    tree.leaves.shrink_to_fit();
+}
+
+size_t ChangeNotifier::parentEnd(std::string_view path)
+{
+    // Last separator, an escaped one is part of a label
+    size_t end = std::string_view::npos;
+    for (size_t i = 0; i < path.size(); i++) {
+        if (path[i] == '\\') {
+            i++;
+        } else if (path[i] == FILE_SEPARATOR[0]) {
+            end = i;
+        }
+    }
+    return end;
+}
+
+std::string ChangeNotifier::entryKey(std::string_view path, std::string_view value)
+{
+    // <parent>/<label> and the value: the siblings of the same label sharing the value
+    std::string key(!path.empty() && path.back() == POSITION_END ? path.substr(0, path.rfind(POSITION_START)) : path);
+    key += '\0';
+    key.append(value);
+    return key;
+}
+
+std::string ChangeNotifier::getDelta(const std::string& featureName, const Tree& before, const Tree& after)
+{
+    // Sections added with their first change
+    ConfigDocument         document;
+    ConfigDocument::NodeId added   = ConfigDocument::NONE;
+    ConfigDocument::NodeId changed = ConfigDocument::NONE;
+    ConfigDocument::NodeId removed = ConfigDocument::NONE;
+    auto                   section = [&document](ConfigDocument::NodeId& id, std::string_view name) {
+        if (id == ConfigDocument::NONE) {
+            id = document.add(ConfigDocument::ROOT, name);
+        }
+        return id;
+    };
+    document.add(ConfigDocument::ROOT, "feature", featureName);
+
+    // Both trees are sorted by path
+    auto previous = before.leaves.begin();
+    auto current  = after.leaves.begin();
+    while (previous != before.leaves.end() || current != after.leaves.end()) {
+        if (current == after.leaves.end() ||
+            (previous != before.leaves.end() && before.path(*previous) < after.path(*current))) {
+            document.add(section(removed, "removed"), before.path(*previous), before.value(*previous));
+            ++previous;
+        } else if (previous == before.leaves.end() || after.path(*current) < before.path(*previous)) {
+            document.add(section(added, "added"), after.path(*current), after.value(*current));
+            ++current;
+        } else {
+            if (before.value(*previous) != after.value(*current)) {
+                document.add(section(changed, "changed"), after.path(*current), after.value(*current));
+            }
+            ++previous;
+            ++current;
+        }
+    }
+    // Only the feature name
+    if (document.size() == 2) {
+        return {};
+    }
+
+    std::string delta;
+    document.writeJson(delta);
+    return delta;
+}
+
+} // namespace config
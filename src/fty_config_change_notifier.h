@@ -0,0 +1,104 @@
+/*  =========================================================================
+    fty_config_change_notifier - Fty config change notifier
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+
+#include "fty_config_feature_registry.h"
+#include "fty_config_watcher.h"
+#include "fty_config_worker_pool.h"
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace config {
+/**
+ * Publish the changes of the feature files: a changed file tree is compared to the last known one,
+ * only the leaves added, changed or removed are published.
+ */
+class ChangeNotifier
+{
+public:
+    /**
+     * Called with the feature name and its delta:
+     * {"feature": name, "added": {path: value}, "changed": {path: value}, "removed": {path: previous value}}
+     * A section without changes is omitted.
+     * Paths are Augeas paths relative to the feature file, as the subtree filters of the requests. An entry, a node
+     * with a value and children, is selected by its value when it is unique among its siblings of the same label:
+     * iface[.="eth0"]/address. The other duplicated labels keep their position: key[2].
+     */
+    using Publisher = std::function<void(const std::string& featureName, const std::string& delta)>;
+
+    /**
+     * Read the current tree of every feature, then watch their files
+     * @param features Features to watch
+     * @param pool Workers reading the file trees
+     * @param debounce Quiet period after the last write of a burst, see FileWatcher
+     * @param publisher Called by the watcher thread for each changed feature
+     */
+    ChangeNotifier(const FeatureRegistry& features, AugeasWorkerPool& pool, std::chrono::milliseconds debounce,
+        Publisher publisher);
+    ~ChangeNotifier();
+
+    ChangeNotifier(const ChangeNotifier&) = delete;
+    ChangeNotifier& operator=(const ChangeNotifier&) = delete;
+
+private:
+    // Leaves of a file sorted by path (Augeas path relative to the file), their text in a single buffer
+    struct Tree
+    {
+        struct Leaf
+        {
+            uint32_t path, pathSize, value, valueSize;
+        };
+        std::string       text;
+        std::vector<Leaf> leaves;
+
+        std::string_view path(const Leaf& leaf) const
+        {
+            return std::string_view(text).substr(leaf.path, leaf.pathSize);
+        }
+        std::string_view value(const Leaf& leaf) const
+        {
+            return std::string_view(text).substr(leaf.value, leaf.valueSize);
+        }
+    };
+
+    const FeatureRegistry&       m_features;
+    AugeasWorkerPool&            m_pool;
+    Publisher                    m_publisher;
+    // Last known tree of each feature, only used by the watcher thread once started
+    std::map<std::string, Tree>  m_trees;
+    std::unique_ptr<FileWatcher> m_watcher;
+
+    void               onChange(const std::set<std::string>& files);
+    void               readTrees(const std::set<std::string>& featureNames, std::map<std::string, Tree>& trees);
+    static void        readTree(AugeasHandle& aug, const FeatureDefinition& feature, Tree& tree);
+    static size_t      parentEnd(std::string_view path);
+    static std::string entryKey(std::string_view path, std::string_view value);
+    static std::string getDelta(const std::string& featureName, const Tree& before, const Tree& after);
+};
+
+} // namespace config
@@ -0,0 +1,152 @@
+/*  =========================================================================
+    fty_config_compression - Fty config feature payload compression
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+ */
+
+/*
+@header
+    fty_config_compression - Fty config feature payload compression
+@discuss
+    Feature data is text in the SRR messages, so the zstd frame is base64 encoded and
+    prefixed by "zstd:". A JSON document never starts with this prefix, a restore can
+    then accept both raw and compressed payloads.
+@end
+ */
+
+#include "fty_config_compression.h"
+#include "fty_config_exception.h"
+#include <cstdint>
+#include <zstd.h>
+
+namespace config {
+
+static constexpr char BASE64_CHARS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static void base64Encode(std::string_view input, std::string& output)
+{
+    output.reserve(output.size() + (input.size() + 2) / 3 * 4);
+    size_t i = 0;
+    for (; i + 2 < input.size(); i += 3) {
+        uint32_t bits = uint32_t(uint8_t(input[i])) << 16 | uint32_t(uint8_t(input[i + 1])) << 8 |
+                        uint32_t(uint8_t(input[i + 2]));
+        output += BASE64_CHARS[(bits >> 18) & 0x3F];
+        output += BASE64_CHARS[(bits >> 12) & 0x3F];
+        output += BASE64_CHARS[(bits >> 6) & 0x3F];
+        output += BASE64_CHARS[bits & 0x3F];
+    }
+    if (i < input.size()) {
+        uint32_t bits = uint32_t(uint8_t(input[i])) << 16;
+        if (i + 1 < input.size()) {
+            bits |= uint32_t(uint8_t(input[i + 1])) << 8;
+        }
+        output += BASE64_CHARS[(bits >> 18) & 0x3F];
+        output += BASE64_CHARS[(bits >> 12) & 0x3F];
+        output += i + 1 < input.size() ? BASE64_CHARS[(bits >> 6) & 0x3F] : '=';
+        output += '=';
+    }
+}
+
+static void base64Decode(std::string_view input, std::string& output)
+{
+    if (input.size() % 4 != 0) {
+        throw ConfigurationException("Invalid base64 payload length");
+    }
+    output.reserve(input.size() / 4 * 3);
+    uint32_t bits  = 0;
+    int      count = 0;
+    size_t   pad   = 0;
+    for (size_t i = 0; i < input.size(); i++) {
+        char     c = input[i];
+        uint32_t value;
+        if (c >= 'A' && c <= 'Z') {
+            value = uint32_t(c - 'A');
+        } else if (c >= 'a' && c <= 'z') {
+            value = uint32_t(c - 'a' + 26);
+        } else if (c >= '0' && c <= '9') {
+            value = uint32_t(c - '0' + 52);
+        } else if (c == '+') {
+            value = 62;
+        } else if (c == '/') {
+            value = 63;
+        } else if (c == '=' && i + 2 >= input.size()) {
+            value = 0;
+            pad++;
+        } else {
+            throw ConfigurationException("Invalid base64 payload character");
+        }
+        if (pad > 0 && c != '=') {
+            throw ConfigurationException("Invalid base64 payload padding");
+        }
+        bits = bits << 6 | value;
+        if (++count == 4) {
+            output += char((bits >> 16) & 0xFF);
+            output += char((bits >> 8) & 0xFF);
+            output += char(bits & 0xFF);
+            bits  = 0;
+            count = 0;
+        }
+    }
+    output.resize(output.size() - pad);
+}
+
+bool compressPayload(std::string_view data, int level, std::string& payload)
+{
+    std::string frame(ZSTD_compressBound(data.size()), '\0');
+    size_t      size = ZSTD_compress(frame.data(), frame.size(), data.data(), data.size(), level);
+    if (ZSTD_isError(size)) {
+        return false;
+    }
+    frame.resize(size);
+
+    std::string compressed(ZSTD_PAYLOAD_PREFIX);
+    base64Encode(frame, compressed);
+    if (compressed.size() >= data.size()) {
+        return false;
+    }
+    payload = std::move(compressed);
+    return true;
+}
+
+bool isCompressedPayload(std::string_view payload)
+{
+    return payload.compare(0, std::char_traits<char>::length(ZSTD_PAYLOAD_PREFIX), ZSTD_PAYLOAD_PREFIX) == 0;
+}
+
+std::string decompressPayload(std::string_view payload)
+{
+    std::string frame;
+    base64Decode(payload.substr(std::char_traits<char>::length(ZSTD_PAYLOAD_PREFIX)), frame);
+
+    // The content size is always stored by ZSTD_compress
+    unsigned long long size = ZSTD_getFrameContentSize(frame.data(), frame.size());
+    if (size == ZSTD_CONTENTSIZE_ERROR || size == ZSTD_CONTENTSIZE_UNKNOWN || size > MAX_DATA_SIZE) {
+        throw ConfigurationException("Invalid compressed payload");
+    }
+    std::string data(size, '\0');
+    size_t      result = ZSTD_decompress(data.data(), data.size(), frame.data(), frame.size());
+    if (ZSTD_isError(result)) {
+        throw ConfigurationException(std::string("Invalid compressed payload: ") + ZSTD_getErrorName(result));
+    }
+    if (result != size) {
+        throw ConfigurationException("Truncated compressed payload");
+    }
+    return data;
+}
+
+} // namespace config
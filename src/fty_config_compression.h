@@ -0,0 +1,58 @@
+/*  =========================================================================
+    fty_config_compression - Fty config feature payload compression
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace config {
+
+// Name of the compression, as negotiated in the query metadata
+constexpr auto ZSTD_COMPRESSION = "zstd";
+// Compressed payloads are this prefix followed by the base64 of the zstd frame
+constexpr auto ZSTD_PAYLOAD_PREFIX = "zstd:";
+// Upper bound of a decompressed feature, the size stored in a frame is not trusted beyond
+constexpr unsigned long long MAX_DATA_SIZE = 64 * 1024 * 1024;
+
+/**
+ * Compress a serialized feature
+ * @param data Serialized feature
+ * @param level zstd compression level
+ * @param payload Compressed payload, set only on success
+ * @return false if the compression failed or saved nothing, the data is then sent as it is
+ */
+bool compressPayload(std::string_view data, int level, std::string& payload);
+
+/**
+ * @return true if the payload is compressed
+ */
+bool isCompressedPayload(std::string_view payload);
+
+/**
+ * Decompress a compressed payload
+ * @param payload Compressed payload
+ * @return Serialized feature
+ * @throw ConfigurationException if the payload is corrupted, or its data larger than MAX_DATA_SIZE
+ */
+std::string decompressPayload(std::string_view payload);
+
+} // namespace config
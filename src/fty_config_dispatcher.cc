@@ -0,0 +1,158 @@
+/*  =========================================================================
+    fty_config_dispatcher - Fty config request dispatcher
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+ */
+
+/*
+@header
+    fty_config_dispatcher - Fty config request dispatcher
+@discuss
+    The message bus callback only queues the request: a slow restore does not prevent the
+    next requests from being read. A full queue applies backpressure on the bus.
+    std::shared_mutex does not say whether readers or writers go first (glibc favours the
+    readers), the request mutex favours the writers.
+@end
+ */
+
+#include "fty_config_dispatcher.h"
+#include <fty_log.h>
+
+namespace config {
+
+RequestDispatcher::RequestDispatcher(size_t workers, size_t queueSize)
+    : m_queueSize(std::max<size_t>(queueSize, 1))
+{
+    for (size_t i = 0; i < std::max<size_t>(workers, 1); i++) {
+        m_threads.emplace_back(&RequestDispatcher::run, this);
+    }
+}
+
+RequestDispatcher::~RequestDispatcher()
+{
+    stop();
+}
+
+bool RequestDispatcher::post(Task task)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_tasks.size() >= m_queueSize && !m_stop) {
+        log_warning("Request queue full (%zu), waiting for a free worker", m_tasks.size());
+        m_notFull.wait(lock, [this] {
+            return m_stop || m_tasks.size() < m_queueSize;
+        });
+    }
+    if (m_stop) {
+        return false;
+    }
+    m_tasks.push_back(std::move(task));
+    lock.unlock();
+    m_notEmpty.notify_one();
+    return true;
+}
+
+void RequestDispatcher::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_notEmpty.notify_all();
+    m_notFull.notify_all();
+    for (auto& thread : m_threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+void RequestDispatcher::run()
+{
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_notEmpty.wait(lock, [this] {
+                return m_stop || !m_tasks.empty();
+            });
+            if (m_tasks.empty()) {
+                return;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        m_notFull.notify_one();
+
+        try {
+            task();
+        } catch (std::exception& ex) {
+            log_error("Request failed: %s", ex.what());
+        } catch (...) {
+            log_error("Request failed: unknown error");
+        }
+    }
+}
+
+void RequestMutex::lock()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_waitingWriters++;
+    m_writersCv.wait(lock, [this] {
+        return !m_writer && m_readers == 0;
+    });
+    m_waitingWriters--;
+    m_writer = true;
+}
+
+void RequestMutex::unlock()
+{
+    bool writerNext;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_writer   = false;
+        writerNext = m_waitingWriters > 0;
+    }
+    if (writerNext) {
+        m_writersCv.notify_one();
+    } else {
+        m_readersCv.notify_all();
+    }
+}
+
+void RequestMutex::lock_shared()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_readersCv.wait(lock, [this] {
+        return !m_writer && m_waitingWriters == 0;
+    });
+    m_readers++;
+}
+
+void RequestMutex::unlock_shared()
+{
+    bool lastReader;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        lastReader = --m_readers == 0 && m_waitingWriters > 0;
+    }
+    if (lastReader) {
+        m_writersCv.notify_one();
+    }
+}
+
+} // namespace config
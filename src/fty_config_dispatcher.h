@@ -0,0 +1,96 @@
+/*  =========================================================================
+    fty_config_dispatcher - Fty config request dispatcher
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace config {
+/**
+ * Run the requests on worker threads, through a bounded queue.
+ * When the queue is full, post blocks: the message bus stops reading new requests until a worker is free.
+ */
+class RequestDispatcher
+{
+public:
+    using Task = std::function<void()>;
+
+    /**
+     * @param workers Number of worker threads
+     * @param queueSize Maximum number of pending requests
+     */
+    RequestDispatcher(size_t workers, size_t queueSize);
+    ~RequestDispatcher();
+
+    RequestDispatcher(const RequestDispatcher&) = delete;
+    RequestDispatcher& operator=(const RequestDispatcher&) = delete;
+
+    /**
+     * Queue a task, wait for a free slot if the queue is full
+     * @return false if the dispatcher is stopped, the task is then dropped
+     */
+    bool post(Task task);
+
+    /**
+     * Stop accepting tasks, run the pending ones and wait for the workers
+     */
+    void stop();
+
+private:
+    size_t                   m_queueSize;
+    std::mutex               m_mutex;
+    std::condition_variable  m_notEmpty;
+    std::condition_variable  m_notFull;
+    std::deque<Task>         m_tasks;
+    bool                     m_stop = false;
+    std::vector<std::thread> m_threads;
+
+    void run();
+};
+
+/**
+ * Shared mutex of the requests: saves share it, restores and resets own it. A writer waiting for the lock blocks
+ * the new readers, so that a restore is not delayed for ever by a stream of overlapping saves.
+ * Meets the SharedMutex requirements used by std::unique_lock and std::shared_lock (no try_lock).
+ */
+class RequestMutex
+{
+public:
+    void lock();
+    void unlock();
+    void lock_shared();
+    void unlock_shared();
+
+private:
+    std::mutex              m_mutex;
+    std::condition_variable m_readersCv;
+    std::condition_variable m_writersCv;
+    size_t                  m_readers        = 0;
+    size_t                  m_waitingWriters = 0;
+    bool                    m_writer         = false;
+};
+
+} // namespace config
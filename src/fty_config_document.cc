@@ -0,0 +1,294 @@
+/*  =========================================================================
+    fty_config_document - Fty config document
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+ */
+
+/*
+@header
+    fty_config_document - Fty config document
+@discuss
+    In-memory form of an exported configuration. Building it costs no heap allocation per
+    node once the capacity is reserved: nodes live in a single array, their text in a
+    monotonic arena, and the child lookup goes through an open addressing index keyed by
+    (parent, name). The JSON output is written straight from the nodes, in a buffer sized
+    once. Nothing is freed before the document, which then releases a few blocks.
+
+    The peak memory of an export grows with the payload, not with the tree depth: the
+    document holds a copy of every value (names are interned) when the JSON string, about
+    the same size, is written. The export can't stream from the Augeas walk instead: the
+    subtrees of a filtered export are walked one after the other and merged under their
+    shared members, and the first of a duplicated label is written once its siblings are
+    known. The protobuf data field holds the whole payload in any case.
+@end
+ */
+
+#include "fty_config_document.h"
+#include "fty_config_hash.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+namespace config {
+
+// Arena first block, per expected node: a value and a share of the interned names
+static constexpr size_t TEXT_PER_NODE = 32;
+static constexpr size_t MIN_ARENA     = 1024;
+
+ConfigDocument::ConfigDocument(size_t capacity)
+    : m_arena(std::max(capacity * TEXT_PER_NODE, MIN_ARENA))
+    , m_names(&m_arena)
+{
+    m_index.assign(16, NONE);
+    reserve(capacity + 1);
+    // Root node
+    m_nodes.push_back(Node{NONE, {}, {}});
+}
+
+void ConfigDocument::reserve(size_t capacity)
+{
+    m_nodes.reserve(capacity);
+    size_t slots = m_index.size();
+    while (slots < 2 * capacity) {
+        slots <<= 1;
+    }
+    if (slots > m_index.size()) {
+        rehash(slots);
+    }
+}
+
+size_t ConfigDocument::hash(NodeId parent, std::string_view name)
+{
+    // FNV-1a of the name, seeded with the parent
+    return static_cast<size_t>(fnv1a64(name, FNV1A64_BASIS ^ parent));
+}
+
+ConfigDocument::NodeId ConfigDocument::find(NodeId parent, std::string_view name) const
+{
+    size_t mask = m_index.size() - 1;
+    for (size_t slot = hash(parent, name) & mask; m_index[slot] != NONE; slot = (slot + 1) & mask) {
+        const Node& candidate = m_nodes[m_index[slot]];
+        if (candidate.parent == parent && candidate.name == name) {
+            return m_index[slot];
+        }
+    }
+    return NONE;
+}
+
+std::string_view ConfigDocument::intern(std::string_view name)
+{
+    auto it = m_names.find(name);
+    if (it == m_names.end()) {
+        it = m_names.insert(store(name)).first;
+    }
+    return *it;
+}
+
+std::string_view ConfigDocument::store(std::string_view text)
+{
+    if (text.empty()) {
+        return {};
+    }
+    char* copy = static_cast<char*>(m_arena.allocate(text.size(), 1));
+    std::memcpy(copy, text.data(), text.size());
+    return {copy, text.size()};
+}
+
+ConfigDocument::NodeId ConfigDocument::add(NodeId parent, std::string_view name)
+{
+    NodeId id = static_cast<NodeId>(m_nodes.size());
+    m_nodes.push_back(Node{parent, intern(name), {}});
+
+    m_textSize += name.size();
+
+    Node& parentNode = m_nodes[parent];
+    if (parentNode.lastChild == NONE) {
+        parentNode.firstChild = id;
+    } else {
+        m_nodes[parentNode.lastChild].next = id;
+    }
+    parentNode.lastChild = id;
+
+    // Keep the load factor under 1/2
+    if (2 * m_nodes.size() > m_index.size()) {
+        rehash(2 * m_index.size());
+    }
+    NodeId first = find(parent, name);
+    if (first == NONE) {
+        indexNode(id);
+    } else {
+        m_nodes[id].ordinal = m_nodes[first].sameName++;
+    }
+    return id;
+}
+
+ConfigDocument::NodeId ConfigDocument::add(NodeId parent, std::string_view name, std::string_view value)
+{
+    NodeId id            = add(parent, name);
+    m_nodes[id].value    = store(value);
+    m_nodes[id].hasValue = true;
+    m_textSize += value.size();
+    return id;
+}
+
+ConfigDocument::NodeId ConfigDocument::add(
+    NodeId parent, std::string_view name, std::string_view value, uint32_t ordinal)
+{
+    NodeId id           = add(parent, name, value);
+    m_nodes[id].ordinal = ordinal;
+    m_nodes[id].indexed = true;
+    return id;
+}
+
+void ConfigDocument::indexNode(NodeId id)
+{
+    size_t mask = m_index.size() - 1;
+    size_t slot = hash(m_nodes[id].parent, m_nodes[id].name) & mask;
+    while (m_index[slot] != NONE) {
+        slot = (slot + 1) & mask;
+    }
+    m_index[slot] = id;
+}
+
+void ConfigDocument::rehash(size_t slots)
+{
+    std::vector<NodeId> previous(slots, NONE);
+    previous.swap(m_index);
+    for (NodeId id : previous) {
+        if (id != NONE) {
+            indexNode(id);
+        }
+    }
+}
+
+// Escaped characters of a JSON string, without the quotes
+static void appendEscaped(std::string& out, std::string_view str)
+{
+    static const char hex[] = "0123456789abcdef";
+    size_t            begin = 0;
+    for (size_t i = 0; i < str.size(); i++) {
+        unsigned char c = static_cast<unsigned char>(str[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        out.append(str, begin, i - begin);
+        begin = i + 1;
+        switch (c) {
+            case '"':
+                out += "\\\"";
+                break;
+            case '\\':
+                out += "\\\\";
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            case '\r':
+                out += "\\r";
+                break;
+            case '\t':
+                out += "\\t";
+                break;
+            case '\b':
+                out += "\\b";
+                break;
+            case '\f':
+                out += "\\f";
+                break;
+            default:
+                out += "\\u00";
+                out += hex[c >> 4];
+                out += hex[c & 0xf];
+        }
+    }
+    out.append(str, begin, str.size() - begin);
+}
+
+void writeJsonString(std::string& out, std::string_view str)
+{
+    out += '"';
+    appendEscaped(out, str);
+    out += '"';
+}
+
+void ConfigDocument::writeKey(std::string& out, NodeId id) const
+{
+    const Node& node = m_nodes[id];
+    if (!node.indexed && node.name != ALWAYS_INDEXED_NAME && m_nodes[find(node.parent, node.name)].sameName == 1) {
+        writeJsonString(out, node.name);
+        return;
+    }
+    // Written in place: a duplicated key is common enough (an iface, a list) for a temporary string to show
+    char  digits[10];
+    char* end = std::to_chars(digits, digits + sizeof(digits), node.ordinal).ptr;
+    out += '"';
+    appendEscaped(out, node.name);
+    out.append(INDEXED_NAME_SUFFIX).append(digits, static_cast<size_t>(end - digits)).append("]\"");
+}
+
+bool ConfigDocument::parseIndexedName(std::string_view key, std::string_view& name, uint32_t& ordinal)
+{
+    // <name>name[<digits>]
+    if (key.empty() || key.back() != ']') {
+        return false;
+    }
+    size_t open = key.rfind(INDEXED_NAME_SUFFIX);
+    if (open == std::string_view::npos || open == 0 || open + INDEXED_NAME_SUFFIX.size() + 1 >= key.size()) {
+        return false;
+    }
+    uint32_t value = 0;
+    for (size_t i = open + INDEXED_NAME_SUFFIX.size(); i < key.size() - 1; i++) {
+        if (key[i] < '0' || key[i] > '9') {
+            return false;
+        }
+        value = value * 10 + static_cast<uint32_t>(key[i] - '0');
+    }
+    name    = key.substr(0, open);
+    ordinal = value;
+    return true;
+}
+
+void ConfigDocument::writeJson(std::string& out) const
+{
+    // Quotes, colons, commas and the occasional index take about 8 bytes per node
+    out.reserve(out.size() + m_textSize + 8 * m_nodes.size() + 2);
+    writeJson(out, ROOT);
+}
+
+void ConfigDocument::writeJson(std::string& out, NodeId id) const
+{
+    const Node& node = m_nodes[id];
+    if (node.firstChild != NONE) {
+        out += '{';
+        for (NodeId child = node.firstChild; child != NONE; child = m_nodes[child].next) {
+            if (child != node.firstChild) {
+                out += ',';
+            }
+            writeKey(out, child);
+            out += ':';
+            writeJson(out, child);
+        }
+        out += '}';
+    } else if (node.hasValue) {
+        writeJsonString(out, node.value);
+    } else {
+        out += "null";
+    }
+}
+
+} // namespace config
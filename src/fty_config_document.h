@@ -0,0 +1,152 @@
+/*  =========================================================================
+    fty_config_document - Fty config document
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace config {
+/**
+ * Append a string to out as a JSON string: quoted, with the quotes, backslashes and control characters escaped
+ */
+void writeJsonString(std::string& out, std::string_view str);
+
+/**
+ * Flat tree of a configuration, as exported to JSON.
+ * Nodes are stored contiguously and referenced by index, children are looked up through a hash index.
+ * Names and values are copied in the document arena, names are interned: a label repeated in the whole
+ * file is stored once. All of them are released at once with the document.
+ */
+class ConfigDocument
+{
+public:
+    using NodeId                 = uint32_t;
+    static constexpr NodeId ROOT = 0;
+    static constexpr NodeId NONE = UINT32_MAX;
+
+    struct Node
+    {
+        NodeId           parent;
+        std::string_view name;
+        std::string_view value;
+        bool             hasValue   = false;
+        NodeId           firstChild = NONE;
+        NodeId           lastChild  = NONE;
+        NodeId           next       = NONE;
+        // Rank among the siblings of the same name, and on the first of them, how many they are
+        uint32_t ordinal  = 0;
+        uint32_t sameName = 1;
+        // Rank set by the caller, the name is always written indexed
+        bool indexed = false;
+    };
+
+    /**
+     * JSON has no duplicated keys: siblings sharing a name are written with an index,
+     * e.g. the second "iface" is written "ifacename[1]".
+     */
+    static constexpr std::string_view INDEXED_NAME_SUFFIX = "name[";
+    /**
+     * Names always written indexed, as the payloads of the former iface hotfix
+     */
+    static constexpr std::string_view ALWAYS_INDEXED_NAME = "iface";
+
+    /**
+     * Split an indexed name written by writeJson
+     * @param key JSON key
+     * @param name Name without index, set on success
+     * @param ordinal Rank among the siblings of the same name, set on success
+     * @return false if key is not an indexed name
+     */
+    static bool parseIndexedName(std::string_view key, std::string_view& name, uint32_t& ordinal);
+
+    /**
+     * @param capacity Expected number of nodes, no allocation happens until it is reached
+     */
+    explicit ConfigDocument(size_t capacity = 0);
+
+    ConfigDocument(const ConfigDocument&) = delete;
+    ConfigDocument& operator=(const ConfigDocument&) = delete;
+
+    /**
+     * Find the first child of parent with the given name
+     * @return Child id or NONE
+     */
+    NodeId find(NodeId parent, std::string_view name) const;
+    /**
+     * Append a child to parent, duplicated names are allowed (find returns the first one)
+     * @return Child id
+     */
+    NodeId add(NodeId parent, std::string_view name);
+    NodeId add(NodeId parent, std::string_view name, std::string_view value);
+    /**
+     * Append a child with a known rank among its siblings of the same name, when they are not all in the document
+     * (partial export). The name is always written indexed.
+     * @return Child id
+     */
+    NodeId add(NodeId parent, std::string_view name, std::string_view value, uint32_t ordinal);
+
+    /**
+     * Make room for more nodes
+     */
+    void reserve(size_t capacity);
+
+    const Node& node(NodeId id) const
+    {
+        return m_nodes[id];
+    }
+    size_t size() const
+    {
+        return m_nodes.size();
+    }
+
+    /**
+     * Append the compact JSON form of the document to out, as cxxtools would format it:
+     * a node with children is an object, a node with a value is a string, any other is null.
+     * Duplicated names are indexed, in a single pass.
+     */
+    void writeJson(std::string& out) const;
+
+private:
+    // Text of the nodes, and the distinct names in it
+    std::pmr::monotonic_buffer_resource       m_arena;
+    std::pmr::unordered_set<std::string_view> m_names;
+
+    std::vector<Node>   m_nodes;
+    std::vector<NodeId> m_index;        // open addressing, power of 2 size
+    size_t              m_textSize = 0; // names and values length, to size the JSON output
+
+    void writeJson(std::string& out, NodeId id) const;
+    void writeKey(std::string& out, NodeId id) const;
+
+    std::string_view intern(std::string_view name);
+    std::string_view store(std::string_view text);
+
+    static size_t hash(NodeId parent, std::string_view name);
+    void          indexNode(NodeId id);
+    void          rehash(size_t slots);
+};
+
+} // namespace config
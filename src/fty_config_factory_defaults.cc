@@ -0,0 +1,79 @@
+/*  =========================================================================
+    fty_config_factory_defaults - Fty config factory defaults store
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+ */
+
+/*
+@header
+    fty_config_factory_defaults - Fty config factory defaults store
+@discuss
+    A snapshot file is the version of the data on the first line, then the data as returned
+    by a save. Snapshots are written once, atomically, and never modified afterwards.
+@end
+ */
+
+#include "fty_config_factory_defaults.h"
+#include "fty_config_transaction.h"
+#include <fty_log.h>
+#include <unistd.h>
+
+namespace config {
+
+#define SNAPSHOT_EXTENSION ".default"
+
+FactoryDefaults::FactoryDefaults(const std::string& path)
+    : m_path(path)
+{
+    if (!makeDirectories(m_path)) {
+        log_error("Factory defaults directory %s can't be created", m_path.c_str());
+    }
+}
+
+std::string FactoryDefaults::getFileName(const std::string& featureName) const
+{
+    return m_path + "/" + featureName + SNAPSHOT_EXTENSION;
+}
+
+bool FactoryDefaults::has(const std::string& featureName) const
+{
+    return access(getFileName(featureName).c_str(), R_OK) == 0;
+}
+
+bool FactoryDefaults::get(const std::string& featureName, std::string& version, std::string& data) const
+{
+    std::string content;
+    if (!readFile(getFileName(featureName), content)) {
+        return false;
+    }
+    size_t eol = content.find('\n');
+    if (eol == std::string::npos) {
+        log_error("Factory defaults of %s are corrupted", featureName.c_str());
+        return false;
+    }
+    version = content.substr(0, eol);
+    data    = content.substr(eol + 1);
+    return true;
+}
+
+bool FactoryDefaults::put(const std::string& featureName, const std::string& version, const std::string& data) const
+{
+    return writeFileAtomically(getFileName(featureName), version + "\n" + data, 0600);
+}
+
+} // namespace config
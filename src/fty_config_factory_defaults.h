@@ -0,0 +1,62 @@
+/*  =========================================================================
+    fty_config_factory_defaults - Fty config factory defaults store
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+
+#include <string>
+
+namespace config {
+/**
+ * Factory default snapshots: one file per feature, holding the payload saved at the first boot
+ * (fty-config --capture-defaults), so that a reset is a plain restore of it.
+ */
+class FactoryDefaults
+{
+public:
+    /**
+     * @param path Directory of the snapshots, created if needed
+     */
+    explicit FactoryDefaults(const std::string& path);
+
+    bool has(const std::string& featureName) const;
+
+    /**
+     * Read the snapshot of a feature
+     * @param featureName Feature name
+     * @param version Version of the saved data, set on success
+     * @param data Saved data, set on success
+     * @return false if there is no snapshot for the feature
+     */
+    bool get(const std::string& featureName, std::string& version, std::string& data) const;
+
+    /**
+     * Store the snapshot of a feature
+     * @return false on write failure
+     */
+    bool put(const std::string& featureName, const std::string& version, const std::string& data) const;
+
+private:
+    std::string m_path;
+
+    std::string getFileName(const std::string& featureName) const;
+};
+
+} // namespace config
@@ -0,0 +1,105 @@
+/*  =========================================================================
+    fty_config_feature_registry - Fty config feature registry
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+ */
+
+/*
+@header
+    fty_config_feature_registry - Fty config feature registry
+@discuss
+    Features are read from the configuration file, any number of them: adding a feature
+    does not need a rebuild. The paths used by the requests are computed once here.
+@end
+ */
+
+#include "fty_config_feature_registry.h"
+#include "fty-config.h"
+#include <czmq.h>
+#include <fty_log.h>
+
+namespace config {
+
+#define FILE_SEPARATOR   "/"
+#define AUGEAS_FILES     FILE_SEPARATOR "files"
+#define FEATURES_SECTION "available-features"
+#define LENSES_SECTION   "feature-lenses"
+
+bool FeatureRegistry::add(const std::string& name, const std::string& fileName, const std::string& lens)
+{
+    if (fileName.empty() || fileName.front() != FILE_SEPARATOR[0]) {
+        log_error("Feature %s ignored, invalid configuration file: '%s'", name.c_str(), fileName.c_str());
+        return false;
+    }
+    FeatureDefinition& feature = m_features[name];
+    feature.name               = name;
+    feature.fileName           = fileName;
+    feature.augeasPath         = AUGEAS_FILES + fileName;
+    feature.rootMember         = fileName.substr(fileName.find_last_of(FILE_SEPARATOR) + 1);
+    feature.lens               = lens;
+    return true;
+}
+
+void FeatureRegistry::load(const std::string& configFile)
+{
+    zconfig_t* root = zconfig_load(configFile.c_str());
+    if (!root) {
+        log_error("Feature registry: unable to load %s", configFile.c_str());
+        return;
+    }
+    zconfig_t* section = zconfig_locate(root, FEATURES_SECTION);
+    if (section) {
+        zconfig_t* lenses = zconfig_locate(root, LENSES_SECTION);
+
+        std::map<std::string, FeatureDefinition> defaults;
+        defaults.swap(m_features);
+        for (zconfig_t* item = zconfig_child(section); item; item = zconfig_next(item)) {
+            const char* name     = zconfig_name(item);
+            const char* fileName = zconfig_value(item);
+            if (!fileName || !*fileName) {
+                log_debug("Feature %s disabled", name);
+                continue;
+            }
+            auto        previous = defaults.find(name);
+            std::string lens     = previous != defaults.end() ? previous->second.lens : DEFAULT_FEATURE_LENS;
+            if (lenses) {
+                lens = zconfig_get(lenses, name, lens.c_str());
+            }
+            add(name, fileName, lens);
+        }
+    }
+    zconfig_destroy(&root);
+    log_debug("Feature registry: %zu features", m_features.size());
+}
+
+const FeatureDefinition* FeatureRegistry::find(const std::string& name) const
+{
+    auto it = m_features.find(name);
+    return it != m_features.end() ? &it->second : nullptr;
+}
+
+FileLenses FeatureRegistry::fileLenses() const
+{
+    FileLenses fileLenses;
+    for (const auto& item : m_features) {
+        fileLenses[item.second.fileName] = item.second.lens;
+    }
+    return fileLenses;
+}
+
+} // namespace config
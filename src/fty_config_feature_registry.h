@@ -0,0 +1,87 @@
+/*  =========================================================================
+    fty_config_feature_registry - Fty config feature registry
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+
+#include "fty_config_augeas.h"
+#include <map>
+#include <string>
+
+namespace config {
+/**
+ * A feature: a configuration file saved and restored as a whole
+ */
+struct FeatureDefinition
+{
+    std::string name;
+    // Configuration file full path
+    std::string fileName;
+    // Augeas path of the file tree ("/files" + file name)
+    std::string augeasPath;
+    // File name without its directory, the member under which a tree is exported
+    std::string rootMember;
+    // Augeas lens parsing the file
+    std::string lens;
+};
+
+/**
+ * Features known by the agent, built once at startup
+ */
+class FeatureRegistry
+{
+public:
+    /**
+     * Register (or replace) a feature
+     * @param name Feature name
+     * @param fileName Configuration file full path, the feature is ignored if it is not absolute
+     * @param lens Augeas lens parsing the file
+     * @return false if the feature is ignored
+     */
+    bool add(const std::string& name, const std::string& fileName, const std::string& lens);
+
+    /**
+     * Replace the features by the "available-features" section of the agent configuration file, if any.
+     * The lens of a feature comes from the "feature-lenses" section, or the lens of the feature registered
+     * under the same name before, or the default lens.
+     * @param configFile Agent configuration file
+     */
+    void load(const std::string& configFile);
+
+    /**
+     * @return The feature, nullptr if unknown
+     */
+    const FeatureDefinition* find(const std::string& name) const;
+
+    const std::map<std::string, FeatureDefinition>& features() const
+    {
+        return m_features;
+    }
+
+    /**
+     * @return Lens of every feature file
+     */
+    FileLenses fileLenses() const;
+
+private:
+    std::map<std::string, FeatureDefinition> m_features;
+};
+
+} // namespace config
@@ -0,0 +1,45 @@
+/*  =========================================================================
+    fty_config_hash - Fty config hash function
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace config {
+
+// FNV-1a 64 bits offset basis, the initial state of the hash
+constexpr uint64_t FNV1A64_BASIS = 14695981039346656037ULL;
+
+/**
+ * 64 bits FNV-1a hash of data
+ * @param hash Initial state, FNV1A64_BASIS or a seeded one
+ */
+inline uint64_t fnv1a64(std::string_view data, uint64_t hash = FNV1A64_BASIS)
+{
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+} // namespace config
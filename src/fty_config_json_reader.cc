@@ -0,0 +1,257 @@
+/*  =========================================================================
+    fty_config_json_reader - Fty config JSON leaf reader
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+ */
+
+/*
+@header
+    fty_config_json_reader - Fty config JSON leaf reader
+@discuss
+    A restore only needs the path and the value of each leaf: the payload is read in place,
+    each leaf is handed over as soon as it is parsed, with the keys leading to it. Keys and
+    values are unescaped in buffers reused for every leaf.
+@end
+ */
+
+#include "fty_config_json_reader.h"
+#include "fty_config_exception.h"
+#include <cctype>
+
+namespace config {
+
+// Protects the stack from hostile payloads, configuration trees are far less deep.
+static constexpr size_t MAX_DEPTH = 64;
+
+void JsonLeafReader::read(std::string_view json, const Handler& handler)
+{
+    m_json  = json;
+    m_pos   = 0;
+    m_depth = 0;
+    readValue(0, handler);
+    skipSpaces();
+    if (m_pos != m_json.size()) {
+        error("unexpected data after the document");
+    }
+}
+
+void JsonLeafReader::readValue(size_t depth, const Handler& handler)
+{
+    skipSpaces();
+    char c = peek();
+    if (c == '{' || c == '[') {
+        if (depth >= MAX_DEPTH) {
+            error("document too deep");
+        }
+        if (m_keys.size() <= depth) {
+            m_keys.resize(depth + 1);
+        }
+        char end = c == '{' ? '}' : ']';
+        m_pos++;
+        skipSpaces();
+        if (peek() == end) {
+            m_pos++;
+            return;
+        }
+        while (true) {
+            skipSpaces();
+            if (c == '{') {
+                if (next() != '"') {
+                    error("key expected");
+                }
+                readString(m_keys[depth]);
+                skipSpaces();
+                if (next() != ':') {
+                    error("':' expected");
+                }
+            } else {
+                m_keys[depth].clear();
+            }
+            readValue(depth + 1, handler);
+            skipSpaces();
+            char separator = next();
+            if (separator == end) {
+                return;
+            }
+            if (separator != ',') {
+                error("',' expected");
+            }
+        }
+    }
+
+    if (c == '"') {
+        m_pos++;
+        readString(m_value);
+    } else {
+        readLiteral();
+    }
+    m_depth = depth;
+    handler(*this);
+}
+
+void JsonLeafReader::readString(std::string& out)
+{
+    out.clear();
+    while (true) {
+        // Copy the unescaped runs at once
+        size_t begin = m_pos;
+        while (m_pos < m_json.size() && m_json[m_pos] != '"' && m_json[m_pos] != '\\') {
+            if (static_cast<unsigned char>(m_json[m_pos]) < 0x20) {
+                error("control character in string");
+            }
+            m_pos++;
+        }
+        out.append(m_json.data() + begin, m_pos - begin);
+
+        char c = next();
+        if (c == '"') {
+            return;
+        }
+        switch (next()) {
+            case '"':
+                out += '"';
+                break;
+            case '\\':
+                out += '\\';
+                break;
+            case '/':
+                out += '/';
+                break;
+            case 'b':
+                out += '\b';
+                break;
+            case 'f':
+                out += '\f';
+                break;
+            case 'n':
+                out += '\n';
+                break;
+            case 'r':
+                out += '\r';
+                break;
+            case 't':
+                out += '\t';
+                break;
+            case 'u': {
+                uint32_t codePoint = readHex();
+                // Surrogate pair
+                if (codePoint >= 0xD800 && codePoint < 0xDC00) {
+                    if (next() != '\\' || next() != 'u') {
+                        error("invalid surrogate pair");
+                    }
+                    uint32_t low = readHex();
+                    if (low < 0xDC00 || low >= 0xE000) {
+                        error("invalid surrogate pair");
+                    }
+                    codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                }
+                appendUtf8(out, codePoint);
+                break;
+            }
+            default:
+                error("invalid escape sequence");
+        }
+    }
+}
+
+void JsonLeafReader::readLiteral()
+{
+    size_t begin = m_pos;
+    while (m_pos < m_json.size() && (isalnum(static_cast<unsigned char>(m_json[m_pos])) || m_json[m_pos] == '-' ||
+                                        m_json[m_pos] == '+' || m_json[m_pos] == '.')) {
+        m_pos++;
+    }
+    std::string_view literal = m_json.substr(begin, m_pos - begin);
+    if (literal == "null") {
+        m_value.clear();
+    } else if (literal == "true" || literal == "false" ||
+               (!literal.empty() && (literal[0] == '-' || isdigit(static_cast<unsigned char>(literal[0]))))) {
+        m_value.assign(literal);
+    } else {
+        error("value expected");
+    }
+}
+
+void JsonLeafReader::appendUtf8(std::string& out, uint32_t codePoint)
+{
+    if (codePoint < 0x80) {
+        out += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+        out += static_cast<char>(0xC0 | (codePoint >> 6));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else if (codePoint < 0x10000) {
+        out += static_cast<char>(0xE0 | (codePoint >> 12));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (codePoint >> 18));
+        out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+uint32_t JsonLeafReader::readHex()
+{
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = next();
+        value <<= 4;
+        if (c >= '0' && c <= '9') {
+            value |= static_cast<uint32_t>(c - '0');
+        } else if (c >= 'a' && c <= 'f') {
+            value |= static_cast<uint32_t>(c - 'a' + 10);
+        } else if (c >= 'A' && c <= 'F') {
+            value |= static_cast<uint32_t>(c - 'A' + 10);
+        } else {
+            error("invalid unicode escape");
+        }
+    }
+    return value;
+}
+
+char JsonLeafReader::next()
+{
+    if (m_pos >= m_json.size()) {
+        error("unexpected end of document");
+    }
+    return m_json[m_pos++];
+}
+
+char JsonLeafReader::peek()
+{
+    if (m_pos >= m_json.size()) {
+        error("unexpected end of document");
+    }
+    return m_json[m_pos];
+}
+
+void JsonLeafReader::skipSpaces()
+{
+    while (m_pos < m_json.size() &&
+           (m_json[m_pos] == ' ' || m_json[m_pos] == '\t' || m_json[m_pos] == '\n' || m_json[m_pos] == '\r')) {
+        m_pos++;
+    }
+}
+
+void JsonLeafReader::error(const char* what) const
+{
+    throw ConfigurationException("Invalid JSON at offset " + std::to_string(m_pos) + ": " + what);
+}
+
+} // namespace config
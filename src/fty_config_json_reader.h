@@ -0,0 +1,88 @@
+/*  =========================================================================
+    fty_config_json_reader - Fty config JSON leaf reader
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace config {
+/**
+ * Read the leaves of a JSON document in document order, without building the document
+ */
+class JsonLeafReader
+{
+public:
+    using Handler = std::function<void(const JsonLeafReader& leaf)>;
+
+    /**
+     * Parse json, handler is called for each scalar value
+     * @throw ConfigurationException if json is not valid, after the leaves before the error were handled
+     */
+    void read(std::string_view json, const Handler& handler);
+
+    /**
+     * @return Number of keys from the root to the current leaf, 0 for a scalar document
+     */
+    size_t depth() const
+    {
+        return m_depth;
+    }
+
+    /**
+     * @return Key of level (< depth) leading to the current leaf, empty for an array element
+     */
+    const std::string& key(size_t level) const
+    {
+        return m_keys[level];
+    }
+
+    /**
+     * @return Current leaf value: unescaped string, number and boolean as written, empty for null
+     */
+    const std::string& value() const
+    {
+        return m_value;
+    }
+
+private:
+    std::string_view m_json;
+    size_t           m_pos   = 0;
+    size_t           m_depth = 0;
+    // Buffers reused from one leaf (and one document) to the next
+    std::vector<std::string> m_keys;
+    std::string              m_value;
+
+    void              readValue(size_t depth, const Handler& handler);
+    void              readString(std::string& out);
+    void              readLiteral();
+    uint32_t          readHex();
+    char              next();
+    char              peek();
+    void              skipSpaces();
+    [[noreturn]] void error(const char* what) const;
+    static void       appendUtf8(std::string& out, uint32_t codePoint);
+};
+
+} // namespace config
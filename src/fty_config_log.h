@@ -0,0 +1,42 @@
+/*  =========================================================================
+    fty_config_log - Fty config hot path logging
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+
+#include <fty_log.h>
+
+/**
+ * Log of a single configuration node, on the save and restore hot paths.
+ * The arguments are only evaluated when the trace level is enabled (verbose mode),
+ * and defining FTY_CONFIG_NO_NODE_TRACE removes the node logs from the build.
+ */
+#ifdef FTY_CONFIG_NO_NODE_TRACE
+#define log_node(...)                                                                                                  \
+    do {                                                                                                               \
+    } while (0)
+#else
+#define log_node(...)                                                                                                  \
+    do {                                                                                                               \
+        if (ftylog_getInstance()->isLogTrace()) {                                                                      \
+            log_trace(__VA_ARGS__);                                                                                    \
+        }                                                                                                              \
+    } while (0)
+#endif
@@ -28,13 +28,26 @@
 
 #include "fty_config_manager.h"
 #include "fty-config.h"
+#include "fty_config_change_notifier.h"
+#include "fty_config_compression.h"
+#include "fty_config_dispatcher.h"
+#include "fty_config_document.h"
+#include "fty_config_log.h"
+#include "fty_config_metrics.h"
 #include "fty_config_exception.h"
+#include "fty_config_factory_defaults.h"
+#include "fty_config_snapshot_store.h"
+#include "fty_config_transaction.h"
+#include <algorithm>
 #include <augeas.h>
+#include <cctype>
+#include <cstring>
+#include <cxxtools/serializationinfo.h>
 #include <fty_common.h>
 #include <iostream>
 #include <list>
 #include <memory>
-#include <regex>
+#include <set>
 #include <sstream>
 #include <vector>
 
@@ -43,55 +56,155 @@ using namespace JSON;
 using namespace dto::srr;
 
 namespace config {
-//__>> HOTFIX Network config is not a proper JSON due to several "iface" attribut in the Json
-// Solution: index the iface (rename ifacename) for the output and remove the index when restore
-// Functions
-static std::string createIndexForIface(std::string json);
-static std::string removeIndexForIface(const std::string& json);
-//__<< HOTFIX
 
 #define FILE_SEPARATOR     "/"
 #define AUGEAS_FILES       FILE_SEPARATOR "files"
 #define ANY_NODES          FILE_SEPARATOR "*"
 #define COMMENTS_DELIMITER "#"
+#define DESCENDANT_NODES   FILE_SEPARATOR "descendant::*"
+#define SUBTREE_NODES      FILE_SEPARATOR "descendant-or-self::*"
+#define FILTER_SEPARATOR   ','
+#define FILTER_FORBIDDEN   "[]*\\|$()'\"="
+#define POSITION_START     '['
+#define POSITION_END       ']'
+#define EXPORT_NODES_VAR   "fty_config_export"
+#define AUGEAS_ERRORS      FILE_SEPARATOR "augeas" AUGEAS_FILES
+#define SNAPSHOT_ON_SAVE   "save"
+#define SNAPSHOT_ON_CHANGE "change"
 
-const static std::regex augeasArrayregex("(\\w+\\[.*\\])$", std::regex::optimize);
+ConfigurationManager::ConfigurationManager(
+    const std::map<std::string, std::string>& parameters, const FeatureRegistry& features)
+    : ConfigurationManager(parameters, features, nullptr)
+{
+}
 
-ConfigurationManager::ConfigurationManager(const std::map<std::string, std::string>& parameters)
+ConfigurationManager::ConfigurationManager(const std::map<std::string, std::string>& parameters,
+    const FeatureRegistry& features, std::unique_ptr<messagebus::MessageBus> msgBus)
     : m_parameters(parameters)
-    , m_aug(nullptr, aug_close)
+    , m_features(features)
+    , m_msgBus(std::move(msgBus))
 {
     init();
 }
 
+ConfigurationManager::ConfigurationManager(
+    const std::map<std::string, std::string>& parameters, const FeatureRegistry& features, Offline)
+    : m_parameters(parameters)
+    , m_features(features)
+{
+    // Errors are up to the caller, there is no agent to keep running.
+    initEngines();
+}
+
+ConfigurationManager::~ConfigurationManager()
+{
+    // No more change published
+    m_notifier.reset();
+    // Pending requests are processed (and answered) before the message bus goes away.
+    if (m_dispatcher) {
+        m_dispatcher->stop();
+    }
+    m_msgBus.reset();
+}
+
 void ConfigurationManager::init()
 {
     try {
-        // Augeas tool init
-        int augeasOpt = getAugeasFlags(m_parameters.at(AUGEAS_OPTIONS));
-        log_debug("augeas options: %d", augeasOpt);
+        initEngines();
+        connect();
+    } catch (messagebus::MessageBusException& ex) {
+        log_error("Message bus error: %s", ex.what());
+    } catch (...) {
+        log_error("Unexpected error: unknown");
+    }
+}
+
+void ConfigurationManager::initEngines()
+{
+    // Augeas tool init
+    int augeasOpt = getAugeasFlags(m_parameters.at(AUGEAS_OPTIONS));
+    log_debug("augeas options: %d", augeasOpt);
+
+    // Lenses of the feature files, the only ones compiled with AUG_NO_MODL_AUTOLOAD
+    FileLenses fileLenses = m_features.fileLenses();
+
+    // Files are loaded on demand, only those of the requested features, below the root.
+    const std::string& root = m_parameters.at(AUGEAS_ROOT_KEY);
 
-        m_aug = AugeasSmartPtr(
-            aug_init(FILE_SEPARATOR, m_parameters.at(AUGEAS_LENS_PATH).c_str(), AUG_NONE /*augeasOpt*/), aug_close);
-        if (!m_aug) {
-            throw ConfigurationException("Augeas tool initialization failed");
+    m_aug = std::make_unique<AugeasHandle>(root, m_parameters.at(AUGEAS_LENS_PATH), augeasOpt, fileLenses);
+    // Srr version
+    m_configVersion = m_parameters.at(CONFIG_VERSION_KEY);
+
+    // Factory defaults, captured at first boot (see captureFactoryDefaults)
+    m_factoryDefaults = std::make_unique<FactoryDefaults>(m_parameters.at(FACTORY_DEFAULTS_PATH_KEY));
+
+    // Snapshot history
+    size_t historySize = std::stoul(m_parameters.at(HISTORY_SIZE_KEY));
+    if (historySize > 0) {
+        try {
+            m_history = std::make_unique<SnapshotStore>(m_parameters.at(HISTORY_PATH_KEY), historySize);
+        } catch (std::exception& ex) {
+            log_error("Snapshot history disabled: %s", ex.what());
         }
+    }
+
+    // Save workers, each with its own Augeas handle
+    size_t saveWorkers = std::stoul(m_parameters.at(SAVE_WORKERS_KEY));
+    if (saveWorkers == 0) {
+        saveWorkers = std::thread::hardware_concurrency();
+    }
+    log_debug("Save workers: %zu", saveWorkers);
+    m_savePool = std::make_unique<AugeasWorkerPool>(
+        saveWorkers, root, m_parameters.at(AUGEAS_LENS_PATH), augeasOpt, fileLenses);
+}
+
+void ConfigurationManager::connect()
+{
+    // Metrics, dumped periodically in the stats file
+    m_metrics.startDump(
+        m_parameters.at(STATS_FILE_KEY), std::chrono::seconds(std::stoul(m_parameters.at(STATS_PERIOD_KEY))));
 
-        // Message bus init
+    // Requests are processed by workers: saves run concurrently, restores and resets one at a time.
+    m_dispatcher = std::make_unique<RequestDispatcher>(
+        std::stoul(m_parameters.at(REQUEST_WORKERS_KEY)), std::stoul(m_parameters.at(REQUEST_QUEUE_SIZE_KEY)));
+
+    // Message bus init
+    if (!m_msgBus) {
         m_msgBus = std::unique_ptr<messagebus::MessageBus>(
             messagebus::MlmMessageBus(m_parameters.at(ENDPOINT_KEY), m_parameters.at(AGENT_NAME_KEY)));
-        m_msgBus->connect();
-
-        // Bind all processor handler.
-        m_processor.saveHandler    = std::bind(&ConfigurationManager::saveConfiguration, this, _1);
-        m_processor.restoreHandler = std::bind(&ConfigurationManager::restoreConfiguration, this, _1);
-        m_processor.resetHandler   = std::bind(&ConfigurationManager::resetConfiguration, this, _1);
-        // Srr version
-        m_configVersion = m_parameters.at(CONFIG_VERSION_KEY);
-
-        // Listen all incoming request
-        auto fct = std::bind(&ConfigurationManager::handleRequest, this, _1);
-        m_msgBus->receive(m_parameters.at(QUEUE_NAME_KEY), fct);
+    }
+    m_msgBus->connect();
+
+    // Listen all incoming request
+    auto fct = std::bind(&ConfigurationManager::handleRequest, this, _1);
+    m_msgBus->receive(m_parameters.at(QUEUE_NAME_KEY), fct);
+
+    // Changes of the feature files are published on a stream.
+    auto debounce = std::chrono::milliseconds(std::stoul(m_parameters.at(CHANGE_DEBOUNCE_KEY)));
+    if (debounce.count() > 0) {
+        try {
+            auto onChange = [this](const std::string& featureName, const std::string& delta) {
+                publishChange(featureName, delta);
+                snapshotFeature(featureName);
+            };
+            m_notifier = std::make_unique<ChangeNotifier>(m_features, *m_savePool, debounce, onChange);
+        } catch (std::exception& ex) {
+            log_error("Change notification disabled: %s", ex.what());
+        }
+    }
+}
+
+void ConfigurationManager::publishChange(const std::string& featureName, const std::string& delta)
+{
+    try {
+        messagebus::Message msg;
+        msg.userData().push_back(delta);
+        msg.metaData().emplace(messagebus::Message::SUBJECT, CHANGE_SUBJECT);
+        msg.metaData().emplace(messagebus::Message::FROM, m_parameters.at(AGENT_NAME_KEY));
+        // The message bus client is shared with the workers.
+        std::lock_guard<std::mutex> lock(m_sendMutex);
+        m_msgBus->publish(m_parameters.at(CHANGE_STREAM_KEY), msg);
+        log_debug("Change of %s published", featureName.c_str());
     } catch (messagebus::MessageBusException& ex) {
         log_error("Message bus error: %s", ex.what());
     } catch (...) {
@@ -99,95 +212,552 @@ void ConfigurationManager::init()
     }
 }
 
+void ConfigurationManager::snapshotFeature(const std::string& featureName)
+{
+    if (!m_history) {
+        return;
+    }
+    try {
+        std::shared_lock<RequestMutex> lock(m_requestMutex);
+        const FeatureDefinition&       feature = *m_features.find(featureName);
+        std::string                    data;
+        m_savePool
+            ->post([this, &feature, &data](AugeasHandle& aug) {
+                // Parsed again, even if rewritten in the same second as the previous load
+                aug.load({feature.fileName}, true);
+                getConfigurationToJson(aug.get(), data, feature);
+            })
+            .get();
+        m_history->add(featureName, m_configVersion, data, SNAPSHOT_ON_CHANGE);
+    } catch (std::exception& ex) {
+        log_error("Snapshot of %s failed: %s", featureName.c_str(), ex.what());
+    }
+}
+
+void ConfigurationManager::listSnapshots(const messagebus::Message& msg)
+{
+    std::set<std::string>       featureNames(msg.userData().begin(), msg.userData().end());
+    cxxtools::SerializationInfo si;
+    si.setCategory(cxxtools::SerializationInfo::Array);
+    for (const auto& info : m_history ? m_history->list() : std::vector<SnapshotInfo>()) {
+        if (!featureNames.empty() && !featureNames.count(info.featureName)) {
+            continue;
+        }
+        cxxtools::SerializationInfo& snapshot = si.addMember("");
+        snapshot.addMember("id") <<= info.id;
+        snapshot.addMember("time") <<= info.time;
+        snapshot.addMember("feature") <<= info.featureName;
+        snapshot.addMember("version") <<= info.version;
+        snapshot.addMember("trigger") <<= info.trigger;
+        snapshot.addMember("hash") <<= info.hash;
+        snapshot.addMember("size") <<= info.size;
+    }
+    dto::UserData dataResponse;
+    dataResponse.push_back(JSON::writeToString(si, false));
+    sendResponse(msg, dataResponse);
+}
+
+void ConfigurationManager::restoreSnapshots(const messagebus::Message& msg)
+{
+    log_debug("Restoring snapshots...");
+    ScopedTimer                          timer(m_metrics, "request.restore_snapshot");
+    messagebus::MetaData                 replyMeta;
+    std::map<FeatureName, FeatureStatus> mapStatus;
+    std::map<FeatureName, Feature>       snapshots;
+    for (const auto& id : msg.userData()) {
+        SnapshotInfo info;
+        std::string  data;
+        char*        end        = nullptr;
+        uint64_t     snapshotId = strtoull(id.c_str(), &end, 10);
+        if (!m_history || id.empty() || *end || !m_history->get(snapshotId, info, data)) {
+            std::string errorMsg = TRANSLATE_ME("Snapshot (%s) not found", id.c_str());
+            log_error(errorMsg.c_str());
+            mapStatus[id].set_status(Status::FAILED);
+            mapStatus[id].set_error(errorMsg);
+        } else if (!snapshots.emplace(info.featureName, Feature()).second) {
+            std::string errorMsg = TRANSLATE_ME("Several snapshots of: (%s)", info.featureName.c_str());
+            log_error(errorMsg.c_str());
+            mapStatus[info.featureName].set_status(Status::FAILED);
+            mapStatus[info.featureName].set_error(errorMsg);
+        } else {
+            Feature& feature = snapshots[info.featureName];
+            feature.set_version(info.version);
+            feature.set_data(std::move(data));
+        }
+    }
+
+    // Same as a restore of the snapshot payloads, metadata included.
+    if (mapStatus.empty()) {
+        std::unique_lock<RequestMutex>        lock(m_requestMutex);
+        std::map<FeatureName, const Feature*> features;
+        for (const auto& item : snapshots) {
+            features.emplace(item.first, &item.second);
+        }
+        mapStatus = restoreFeatures(features, msg.metaData(), replyMeta);
+    } else {
+        for (const auto& item : snapshots) {
+            if (!mapStatus.count(item.first)) {
+                mapStatus[item.first].set_status(Status::FAILED);
+                mapStatus[item.first].set_error(TRANSLATE_ME(
+                    "Restore snapshot for: (%s) cancelled, another snapshot failed!", item.first.c_str()));
+            }
+        }
+    }
+
+    dto::UserData dataResponse;
+    dataResponse << createRestoreResponse(mapStatus);
+    sendResponse(msg, dataResponse, replyMeta);
+    log_debug("Restore snapshots done");
+}
+
+void ConfigurationManager::getMetrics(const messagebus::Message& msg)
+{
+    dto::UserData dataResponse;
+    dataResponse.push_back(m_metrics.toJson());
+    sendResponse(msg, dataResponse);
+}
+
 void ConfigurationManager::handleRequest(messagebus::Message msg)
+{
+    if (!m_dispatcher->post([this, msg]() {
+            processRequest(msg);
+        })) {
+        log_error("Configuration request dropped, agent stopping");
+    }
+}
+
+void ConfigurationManager::processRequest(const messagebus::Message& msg)
 {
     try {
         log_debug("Configuration handle request");
-        // Load augeas for any request (to avoid any cache).
-        aug_load(m_aug.get());
-
+        // Agent requests
+        auto subject = msg.metaData().find(messagebus::Message::SUBJECT);
+        if (subject != msg.metaData().end() && subject->second == LIST_SNAPSHOTS_SUBJECT) {
+            listSnapshots(msg);
+            return;
+        }
+        if (subject != msg.metaData().end() && subject->second == RESTORE_SNAPSHOT_SUBJECT) {
+            restoreSnapshots(msg);
+            return;
+        }
+        if (subject != msg.metaData().end() && subject->second == GET_METRICS_SUBJECT) {
+            getMetrics(msg);
+            return;
+        }
         dto::UserData data = msg.userData();
         // Get the query
         Query query;
         data >> query;
+        // Bind all processor handler, the metadata of the request goes along the query.
+        messagebus::MetaData replyMeta;
+        SrrQueryProcessor    processor;
+        processor.saveHandler = [&](const SaveQuery& saveQuery) {
+            return saveConfiguration(saveQuery, msg.metaData(), replyMeta);
+        };
+        processor.restoreHandler = [&](const RestoreQuery& restoreQuery) {
+            return restoreConfiguration(restoreQuery, msg.metaData(), replyMeta);
+        };
+        processor.resetHandler = [&](const ResetQuery& resetQuery) {
+            return resetConfiguration(resetQuery, msg.metaData(), replyMeta);
+        };
         // Process the query
-        Response response = m_processor.processQuery(query);
+        Response response = processor.processQuery(query);
         // Send the response
         dto::UserData dataResponse;
         dataResponse << response;
-        sendResponse(msg, dataResponse);
+        sendResponse(msg, dataResponse, replyMeta);
     } catch (std::exception& ex) {
         log_error(ex.what());
     }
 }
 
-SaveResponse ConfigurationManager::saveConfiguration(const SaveQuery& query)
+SaveResponse ConfigurationManager::saveConfiguration(
+    const SaveQuery& query, const messagebus::MetaData& queryMeta, messagebus::MetaData& replyMeta)
 {
     log_debug("Saving configuration");
+    ScopedTimer              timer(m_metrics, "request.save");
+    std::vector<std::string> featureNames(query.features().begin(), query.features().end());
+
+    std::map<FeatureName, FeatureAndStatus> mapFeaturesData = saveFeatures(featureNames, queryMeta, replyMeta);
+    log_debug("Save configuration done");
+    return (createSaveResponse(mapFeaturesData, m_configVersion)).save();
+}
+
+std::map<FeatureName, FeatureAndStatus> ConfigurationManager::saveFeatures(
+    const std::vector<std::string>& featureNames, const messagebus::MetaData& queryMeta,
+    messagebus::MetaData& replyMeta)
+{
+    std::shared_lock<RequestMutex>          lock(m_requestMutex);
     std::map<FeatureName, FeatureAndStatus> mapFeaturesData;
 
-    for (const auto& featureName : query.features()) {
-        // Get the full configuration file path name from class variable m_parameters
-        std::string fileNameFullPath = AUGEAS_FILES + m_parameters.at(featureName) + ANY_NODES;
-        log_debug("Configuration file name: %s", fileNameFullPath.c_str());
-
-        // Get the last pattern
-        std::size_t found = (m_parameters.at(featureName)).find_last_of(FILE_SEPARATOR);
-        if (found != std::string::npos) {
-            cxxtools::SerializationInfo si;
-            std::string                 confFileName =
-                (m_parameters.at(featureName)).substr(found + 1, (m_parameters.at(featureName)).length());
+    // Features whose configuration file is unchanged are served from the cache.
+    std::map<FeatureName, std::string> featuresData;
+    std::map<FeatureName, std::string> featuresHash;
+    std::map<FeatureName, FileStamp>   staleFeatures;
+    std::map<FeatureName, FeatureFilter> filters;
+    for (const auto& featureName : featureNames) {
+        const FeatureDefinition* feature = m_features.find(featureName);
+        if (!feature) {
+            std::string errorMsg = TRANSLATE_ME("Save configuration for: (%s) failed, unknown feature!",
+                featureName.c_str());
+            log_error(errorMsg.c_str());
+            mapFeaturesData[featureName].mutable_status()->set_status(Status::FAILED);
+            mapFeaturesData[featureName].mutable_status()->set_error(errorMsg);
+            continue;
+        }
+        log_debug("Configuration file name: %s", feature->fileName.c_str());
+        FeatureFilter filter;
+        if (!getFeatureFilter(queryMeta, featureName, filter)) {
+            std::string errorMsg = TRANSLATE_ME("Save configuration for: (%s) failed, invalid filter!",
+                featureName.c_str());
+            mapFeaturesData[featureName].mutable_status()->set_status(Status::FAILED);
+            mapFeaturesData[featureName].mutable_status()->set_error(errorMsg);
+            continue;
+        }
+
+        if (!featuresData.count(featureName)) {
+            FileStamp stamp(m_aug->systemPath(feature->fileName));
+            // The cache only holds whole files
+            if (!filter.empty()) {
+                featuresData[featureName];
+                staleFeatures.emplace(featureName, stamp);
+                filters.emplace(featureName, std::move(filter));
+            } else if (m_cache.get(featureName, stamp, featuresData[featureName], featuresHash[featureName])) {
+                log_debug("Configuration of %s unchanged, served from cache", featureName.c_str());
+                m_metrics.count("save." + featureName + ".cache_hits", 1);
+            } else {
+                staleFeatures.emplace(featureName, stamp);
+            }
+        }
+    }
+
+    // The others are exported in parallel, each worker loads the feature file in its own Augeas handle.
+    // The file changed since it was cached, so it is always parsed again: the tree of the worker may come from a
+    // load in the same second as the change, which Augeas would not see.
+    std::vector<std::future<void>> exports;
+    for (const auto& stale : staleFeatures) {
+        const FeatureDefinition& feature = *m_features.find(stale.first);
+        std::string&             data    = featuresData[feature.name];
+        const FeatureFilter&     filter  = filters[feature.name];
+        exports.push_back(m_savePool->post([this, &feature, &data, &filter](AugeasHandle& aug) {
+            {
+                ScopedTimer timer(m_metrics, "save." + feature.name + ".load");
+                aug.load({feature.fileName}, true);
+            }
             // Get configuration
-            getConfigurationToJson(si, fileNameFullPath, confFileName);
-            // Persist DTO
-            Feature feature;
-            feature.set_version(m_configVersion);
-            feature.set_data(createIndexForIface(JSON::writeToString(si, false)));
+            getConfigurationToJson(aug.get(), data, feature, filter);
+        }));
+    }
+    // Wait for all the workers before using (or dropping) their results.
+    for (auto& exported : exports) {
+        exported.wait();
+    }
+    for (auto& exported : exports) {
+        exported.get();
+    }
+
+    auto compression = queryMeta.find(COMPRESSION_META);
+    bool compress    = compression != queryMeta.end() && compression->second == ZSTD_COMPRESSION;
+    if (compress) {
+        replyMeta[COMPRESSION_META] = ZSTD_COMPRESSION;
+    }
+    int compressionLevel = std::stoi(m_parameters.at(COMPRESSION_LEVEL_KEY));
+
+    // The response is assembled in the feature name order, whatever the workers completion order.
+    for (auto& item : featuresData) {
+        const std::string& featureName = item.first;
+        std::string&       hash        = featuresHash[featureName];
+        auto               stale       = staleFeatures.find(featureName);
+        if (stale != staleFeatures.end()) {
+            hash = contentHash(item.second);
+            if (!filters.count(featureName)) {
+                m_cache.put(featureName, stale->second, item.second, hash);
+                // Unchanged data adds nothing to the history, which never fails the save
+                if (m_history) {
+                    try {
+                        m_history->add(featureName, m_configVersion, item.second, SNAPSHOT_ON_SAVE);
+                    } catch (std::exception& ex) {
+                        log_error("Snapshot of %s failed: %s", featureName.c_str(), ex.what());
+                    }
+                }
+            }
+        }
+        replyMeta[FEATURE_HASH_META + featureName] = hash;
+        // Persist DTO, built in place
+        FeatureAndStatus& fs = mapFeaturesData[featureName];
+        fs.mutable_feature()->set_version(m_configVersion);
+        fs.mutable_status()->set_status(Status::SUCCESS);
+        // The requester already has this data, only the hash is returned.
+        auto knownHash = queryMeta.find(FEATURE_HASH_META + featureName);
+        if (knownHash != queryMeta.end() && knownHash->second == hash) {
+            log_debug("Configuration of %s unchanged since %s", featureName.c_str(), hash.c_str());
+            replyMeta[FEATURE_UNCHANGED_META + featureName] = "true";
+        } else if (compress && compressPayload(item.second, compressionLevel, *fs.mutable_feature()->mutable_data())) {
+            log_debug("Configuration of %s compressed from %zu to %zu bytes", featureName.c_str(), item.second.size(),
+                fs.feature().data().size());
+        } else {
+            fs.mutable_feature()->set_data(std::move(item.second));
+        }
+    }
+    return mapFeaturesData;
+}
+
+std::map<FeatureName, FeatureStatus> ConfigurationManager::saveToFile(
+    const std::vector<std::string>& featureNames, const std::string& fileName, const messagebus::MetaData& queryMeta)
+{
+    log_debug("Saving configuration to %s", fileName.c_str());
+    ScopedTimer              timer(m_metrics, "request.save_file");
+    std::vector<std::string> names = featureNames;
+    if (names.empty()) {
+        for (const auto& item : m_features.features()) {
+            names.push_back(item.first);
+        }
+    }
+
+    // Plain payloads: the file is meant to be read back, no hash nor compression negotiated.
+    messagebus::MetaData saveMeta, replyMeta;
+    for (const auto& item : queryMeta) {
+        if (item.first.compare(0, strlen(FEATURE_FILTER_META), FEATURE_FILTER_META) == 0) {
+            saveMeta.insert(item);
+        }
+    }
+    std::map<FeatureName, FeatureAndStatus> saved = saveFeatures(names, saveMeta, replyMeta);
 
-            FeatureStatus featureStatus;
-            featureStatus.set_status(Status::SUCCESS);
+    std::map<FeatureName, FeatureStatus> mapStatus;
+    cxxtools::SerializationInfo          si;
+    si.setCategory(cxxtools::SerializationInfo::Object);
+    bool failed = false;
+    for (auto& item : saved) {
+        mapStatus[item.first] = item.second.status();
+        if (item.second.status().status() != Status::SUCCESS) {
+            failed = true;
+            continue;
+        }
+        cxxtools::SerializationInfo& feature = si.addMember(item.first);
+        feature.addMember(CONFIG_VERSION_KEY) <<= item.second.feature().version();
+        feature.addMember(DATA_MEMBER) <<= item.second.feature().data();
+    }
 
-            FeatureAndStatus fs;
-            *(fs.mutable_status())       = featureStatus;
-            *(fs.mutable_feature())      = feature;
-            mapFeaturesData[featureName] = fs;
+    // Same file mode as the feature files, the configuration may hold credentials.
+    if (!failed && !writeFileAtomically(fileName, JSON::writeToString(si, false), 0600)) {
+        std::string errorMsg = TRANSLATE_ME("Save configuration failed, can't write %s", fileName.c_str());
+        log_error(errorMsg.c_str());
+        for (auto& item : mapStatus) {
+            item.second.set_status(Status::FAILED);
+            item.second.set_error(errorMsg);
         }
     }
-    log_debug("Save configuration done");
-    return (createSaveResponse(mapFeaturesData, m_configVersion)).save();
+    log_debug("Save configuration to %s done", fileName.c_str());
+    return mapStatus;
 }
 
-RestoreResponse ConfigurationManager::restoreConfiguration(const RestoreQuery& query)
+std::map<FeatureName, FeatureStatus> ConfigurationManager::restoreFromFile(
+    const std::string& fileName, const messagebus::MetaData& queryMeta, messagebus::MetaData& replyMeta)
+{
+    log_debug("Restoring configuration from %s", fileName.c_str());
+    ScopedTimer timer(m_metrics, "request.restore_file");
+    std::string content;
+    if (!readFile(fileName, content)) {
+        throw ConfigurationException("Can't read " + fileName);
+    }
+
+    // The payloads are the leaves of the second level, {name: {"version": version, "data": payload}}
+    std::map<FeatureName, Feature> saved;
+    JsonLeafReader                 reader;
+    reader.read(content, [&](const JsonLeafReader& leaf) {
+        if (leaf.depth() != 2) {
+            throw ConfigurationException("Invalid configuration file " + fileName);
+        }
+        Feature& feature = saved[leaf.key(0)];
+        if (leaf.key(1) == CONFIG_VERSION_KEY) {
+            feature.set_version(leaf.value());
+        } else if (leaf.key(1) == DATA_MEMBER) {
+            feature.set_data(leaf.value());
+        }
+    });
+
+    std::unique_lock<RequestMutex>        lock(m_requestMutex);
+    std::map<FeatureName, const Feature*> features;
+    for (const auto& item : saved) {
+        features.emplace(item.first, &item.second);
+    }
+    std::map<FeatureName, FeatureStatus> mapStatus = restoreFeatures(features, queryMeta, replyMeta);
+    log_debug("Restore configuration from %s done", fileName.c_str());
+    return mapStatus;
+}
+
+RestoreResponse ConfigurationManager::restoreConfiguration(
+    const RestoreQuery& query, const messagebus::MetaData& queryMeta, messagebus::MetaData& replyMeta)
 {
     log_debug("Restoring configuration...");
+    ScopedTimer                    timer(m_metrics, "request.restore");
+    std::unique_lock<RequestMutex> lock(m_requestMutex);
+
+    // The payloads are read in place, from the query.
+    std::map<FeatureName, const Feature*> features;
+    for (const auto& item : query.map_features_data()) {
+        features.emplace(item.first, &item.second);
+    }
+    std::map<FeatureName, FeatureStatus> mapStatus = restoreFeatures(features, queryMeta, replyMeta);
+
+    log_debug("Restore configuration done");
+    return (createRestoreResponse(mapStatus)).restore();
+}
+
+ResetResponse ConfigurationManager::resetConfiguration(
+    const ResetQuery& query, const messagebus::MetaData& queryMeta, messagebus::MetaData& replyMeta)
+{
+    log_debug("Resetting configuration...");
+    ScopedTimer              timer(m_metrics, "request.reset");
+    std::vector<std::string> featureNames(query.features().begin(), query.features().end());
+
+    std::map<FeatureName, FeatureStatus> mapStatus = resetFeatures(featureNames, queryMeta, replyMeta);
+    log_debug("Reset configuration done");
+    return (createResetResponse(mapStatus)).reset();
+}
+
+std::map<FeatureName, FeatureStatus> ConfigurationManager::resetFeatures(
+    const std::vector<std::string>& featureNames, const messagebus::MetaData& queryMeta, messagebus::MetaData& replyMeta)
+{
+    std::unique_lock<RequestMutex>       lock(m_requestMutex);
     std::map<FeatureName, FeatureStatus> mapStatus;
 
-    RestoreQuery                                 query1          = query;
-    google::protobuf::Map<FeatureName, Feature>& mapFeaturesData = *(query1.mutable_map_features_data());
+    // A reset is the restore of the factory default snapshots.
+    std::map<FeatureName, Feature> defaults;
+    for (const auto& featureName : featureNames) {
+        std::string version, data;
+        // The feature name is part of the factory defaults file name, only a registered one is read.
+        if (!m_features.find(featureName)) {
+            std::string errorMsg =
+                TRANSLATE_ME("Reset configuration for: (%s) failed, unknown feature!", featureName.c_str());
+            log_error(errorMsg.c_str());
+            mapStatus[featureName].set_status(Status::FAILED);
+            mapStatus[featureName].set_error(errorMsg);
+        } else if (m_factoryDefaults->get(featureName, version, data)) {
+            Feature& feature = defaults[featureName];
+            feature.set_version(version);
+            feature.set_data(std::move(data));
+        } else {
+            std::string errorMsg = TRANSLATE_ME("No factory defaults for: (%s)", featureName.c_str());
+            log_error(errorMsg.c_str());
+            mapStatus[featureName].set_status(Status::FAILED);
+            mapStatus[featureName].set_error(errorMsg);
+        }
+    }
 
-    for (const auto& item : mapFeaturesData) {
-        const std::string& featureName = item.first;
-        const Feature&     feature     = item.second;
-        FeatureStatus      featureStatus;
-        bool               compatible = isVerstionCompatible(feature.version());
-        if (compatible) {
-            const std::string& configurationFileName = AUGEAS_FILES + m_parameters.at(featureName);
+    if (mapStatus.empty()) {
+        std::map<FeatureName, const Feature*> features;
+        for (const auto& item : defaults) {
+            features.emplace(item.first, &item.second);
+        }
+        // The keys added since are removed as well.
+        mapStatus = restoreFeatures(features, queryMeta, replyMeta, true);
+    } else {
+        for (const auto& item : defaults) {
+            mapStatus[item.first].set_status(Status::FAILED);
+            mapStatus[item.first].set_error(TRANSLATE_ME(
+                "Reset configuration for: (%s) cancelled, another feature failed!", item.first.c_str()));
+        }
+    }
+    return mapStatus;
+}
+
+std::map<FeatureName, FeatureStatus> ConfigurationManager::restoreFeatures(
+    const std::map<FeatureName, const Feature*>& features, const messagebus::MetaData& queryMeta,
+    messagebus::MetaData& replyMeta, bool replace)
+{
+    std::map<FeatureName, FeatureStatus> mapStatus;
+
+    // A dry run goes through the same steps up to the tree, which is then dropped instead of saved.
+    auto dryRunMeta = queryMeta.find(DRY_RUN_META);
+    bool dryRun     = dryRunMeta != queryMeta.end() && dryRunMeta->second == "true";
+
+    std::vector<std::string> featureNames;
+    for (const auto& item : features) {
+        featureNames.push_back(item.first);
+    }
+    {
+        ScopedTimer timer(m_metrics, "restore.load");
+        loadFeatures(featureNames);
+    }
+
+    // All the features are applied to the tree then saved at once: either every file is restored, or none.
+    // Only the values which differ are set, a feature already up to date costs no write.
+    FileTransaction       transaction;
+    std::set<FeatureName> changedFeatures;
+    bool                  failed = false;
+    for (const auto& item : features) {
+        const std::string& featureName   = item.first;
+        const Feature&     feature       = *item.second;
+        FeatureStatus&     featureStatus = mapStatus[featureName];
+        const auto*        definition    = m_features.find(featureName);
+        FeatureFilter      filter;
+        if (!definition) {
+            std::string errorMsg =
+                TRANSLATE_ME("Restore configuration for: (%s) failed, unknown feature!", featureName.c_str());
+            log_error(errorMsg.c_str());
+            featureStatus.set_status(Status::FAILED);
+            featureStatus.set_error(errorMsg);
+            failed = true;
+        } else if (!getFeatureFilter(queryMeta, featureName, filter)) {
+            std::string errorMsg =
+                TRANSLATE_ME("Restore configuration for: (%s) failed, invalid filter!", featureName.c_str());
+            featureStatus.set_status(Status::FAILED);
+            featureStatus.set_error(errorMsg);
+            failed = true;
+        } else if (isVerstionCompatible(feature.version())) {
+            const std::string& fileName              = definition->fileName;
+            const std::string& configurationFileName = definition->augeasPath;
             log_debug("Restoring configuration for: %s, with configuration file: %s", featureName.c_str(),
                 configurationFileName.c_str());
-
-            cxxtools::SerializationInfo siData;
-            JSON::readFromString(removeIndexForIface(feature.data()), siData);
-            // Get data member
-            int returnValue = setConfiguration(siData, configurationFileName);
-            if (returnValue == 0) {
-                log_debug("Restore configuration done: %s succeed!", featureName.c_str());
-                featureStatus.set_status(Status::SUCCESS);
-            } else {
-                featureStatus.set_status(Status::FAILED);
+            try {
+                // Only a compressed payload is copied, once decompressed.
+                std::string      decompressed;
+                std::string_view data = feature.data();
+                if (isCompressedPayload(data)) {
+                    ScopedTimer timer(m_metrics, "restore." + featureName + ".decompress");
+                    decompressed = decompressPayload(data);
+                    data         = decompressed;
+                }
+                // Parsed and set leaf by leaf
+                size_t      changes;
+                FeatureDiff diff;
+                diff.pathSize = configurationFileName.size() + 1;
+                {
+                    ScopedTimer timer(m_metrics, "restore." + featureName + ".set");
+                    changes = setConfiguration(data, configurationFileName, filter, dryRun ? &diff : nullptr, replace);
+                }
+                log_debug("Restore configuration for: %s, %zu changes", featureName.c_str(), changes);
+                if (dryRun) {
+                    std::string& json = replyMeta[FEATURE_DIFF_META + featureName];
+                    if (diff.document.size() > 1) {
+                        diff.document.writeJson(json);
+                    } else {
+                        json = "{}";
+                    }
+                } else {
+                    m_metrics.count("restore." + featureName + ".changes", changes);
+                }
+                if (!dryRun && changes > 0 && !transaction.backup(m_aug->systemPath(fileName))) {
+                    // Not written without a way back
+                    std::string errorMsg =
+                        TRANSLATE_ME("Restore configuration for: (%s) failed, backup failed!", featureName.c_str());
+                    featureStatus.set_status(Status::FAILED);
+                    featureStatus.set_error(errorMsg);
+                    failed = true;
+                } else {
+                    if (!dryRun && changes > 0) {
+                        changedFeatures.insert(featureName);
+                    }
+                    featureStatus.set_status(Status::SUCCESS);
+                }
+            } catch (std::exception& ex) {
                 std::string errorMsg =
-                    TRANSLATE_ME("Restore configuration for: (%s) failed, access right issue!", featureName.c_str());
+                    TRANSLATE_ME("Restore configuration for: (%s) failed, invalid data!", featureName.c_str());
+                log_error("%s: %s", errorMsg.c_str(), ex.what());
+                featureStatus.set_status(Status::FAILED);
                 featureStatus.set_error(errorMsg);
-                log_error(featureStatus.error().c_str());
+                failed = true;
             }
         } else {
             std::string errorMsg =
@@ -196,19 +766,86 @@ RestoreResponse ConfigurationManager::restoreConfiguration(const RestoreQuery& q
             log_error(errorMsg.c_str());
             featureStatus.set_status(Status::FAILED);
             featureStatus.set_error(errorMsg);
+            failed = true;
         }
-        mapStatus[featureName] = featureStatus;
     }
-    log_debug("Restore configuration done");
-    return (createRestoreResponse(mapStatus)).restore();
+
+    if (dryRun) {
+        // Nothing written, drop the changes of the tree.
+        m_aug->reload();
+        log_debug("Restore dry run done");
+        return mapStatus;
+    }
+
+    // Augeas writes each modified file once, in a temporary file renamed over the original one.
+    if (!failed && !changedFeatures.empty()) {
+        auto start = std::chrono::steady_clock::now();
+        int  saved = aug_save(m_aug->get());
+        m_metrics.record("restore.save", std::chrono::steady_clock::now() - start);
+        if (saved != 0) {
+            failed = true;
+            for (auto& item : mapStatus) {
+                std::string errorMsg =
+                    TRANSLATE_ME("Restore configuration for: (%s) failed, access right issue!", item.first.c_str());
+                log_error("%s %s", errorMsg.c_str(), getSaveError(m_features.find(item.first)->fileName).c_str());
+                item.second.set_status(Status::FAILED);
+                item.second.set_error(errorMsg);
+            }
+        }
+    }
+
+    if (failed) {
+        // Put back the files already written, and drop the changes of the tree.
+        if (!transaction.rollback()) {
+            log_error("Restore configuration rollback failed");
+        }
+        m_aug->reload();
+        for (auto& item : mapStatus) {
+            if (item.second.status() == Status::SUCCESS) {
+                item.second.set_status(Status::FAILED);
+                item.second.set_error(TRANSLATE_ME(
+                    "Restore configuration for: (%s) cancelled, another feature failed!", item.first.c_str()));
+            }
+        }
+    } else {
+        log_debug("Restore configuration done: %zu features succeed!", mapStatus.size());
+    }
+
+    for (const auto& featureName : changedFeatures) {
+        m_cache.invalidate(featureName);
+    }
+    return mapStatus;
 }
 
-ResetResponse ConfigurationManager::resetConfiguration(const dto::srr::ResetQuery& /*query*/)
+std::vector<std::string> ConfigurationManager::captureFactoryDefaults()
 {
-    throw ConfigurationException("Not implemented yet!");
+    std::unique_lock<RequestMutex> lock(m_requestMutex);
+    // Features without factory defaults yet, those of a previous capture are kept.
+    std::vector<std::string> newFeatures;
+    for (const auto& item : m_features.features()) {
+        if (FileStamp(m_aug->systemPath(item.second.fileName)).valid && !m_factoryDefaults->has(item.first)) {
+            newFeatures.push_back(item.first);
+        }
+    }
+    if (newFeatures.empty()) {
+        return {};
+    }
+
+    std::vector<std::string> captured;
+    loadFeatures(newFeatures);
+    for (const auto& featureName : newFeatures) {
+        std::string data;
+        getConfigurationToJson(m_aug->get(), data, *m_features.find(featureName));
+        if (m_factoryDefaults->put(featureName, m_configVersion, data)) {
+            log_info("Factory defaults captured for: %s", featureName.c_str());
+            captured.push_back(featureName);
+        }
+    }
+    return captured;
 }
 
-void ConfigurationManager::sendResponse(const messagebus::Message& msg, const dto::UserData& userData)
+void ConfigurationManager::sendResponse(
+    const messagebus::Message& msg, const dto::UserData& userData, const messagebus::MetaData& metaData)
 {
     try {
         messagebus::Message resp;
@@ -218,6 +855,10 @@ void ConfigurationManager::sendResponse(const messagebus::Message& msg, const dt
         resp.metaData().emplace(messagebus::Message::TO, msg.metaData().find(messagebus::Message::FROM)->second);
         resp.metaData().emplace(
             messagebus::Message::CORRELATION_ID, msg.metaData().find(messagebus::Message::CORRELATION_ID)->second);
+        // Request specific metadata, never overriding the routing ones
+        resp.metaData().insert(metaData.begin(), metaData.end());
+        // The message bus client is shared by all the workers.
+        std::lock_guard<std::mutex> lock(m_sendMutex);
         m_msgBus->sendReply(msg.metaData().find(messagebus::Message::REPLY_TO)->second, resp);
     } catch (messagebus::MessageBusException& ex) {
         log_error("Message bus error: %s", ex.what());
@@ -226,123 +867,437 @@ void ConfigurationManager::sendResponse(const messagebus::Message& msg, const dt
     }
 }
 
-int ConfigurationManager::setConfiguration(cxxtools::SerializationInfo& si, const std::string& path)
+size_t ConfigurationManager::setConfiguration(
+    std::string_view json, const std::string& path, const FeatureFilter& filter, FeatureDiff* diff, bool replace)
 {
-    cxxtools::SerializationInfo::Iterator it;
-    for (it = si.begin(); it != si.end(); ++it) {
-        cxxtools::SerializationInfo*          member     = &(*it);
-        std::string                           memberName = member->name();
-        cxxtools::SerializationInfo::Iterator itElement;
+    size_t changes = 0;
+    // The path buffer is reused for all the leaves.
+    std::string fullPath;
+    if (replace) {
+        // The nodes of the payload and their ancestors, up to the file. The others are removed first: a label
+        // duplicated since can then be set again.
+        std::unordered_set<std::string> nodes;
+        m_jsonReader.read(json, [&](const JsonLeafReader& leaf) {
+            if (getLeafPath(leaf, path, fullPath) && isFiltered(fullPath, path, filter)) {
+                normalizePath(fullPath);
+                for (size_t end = fullPath.size(); end > path.size(); end = fullPath.rfind(FILE_SEPARATOR, end - 1)) {
+                    if (!nodes.emplace(fullPath, 0, end).second) {
+                        break;
+                    }
+                }
+            } else if (leaf.depth() == 1) {
+                // An empty member (e.g. a section without keys) is still one of the file
+                fullPath.assign(path).append(FILE_SEPARATOR).append(leaf.key(0));
+                normalizePath(fullPath);
+                nodes.insert(fullPath);
+            }
+        });
+        changes += removeOtherNodes(path, filter, nodes, diff);
+    }
+    m_jsonReader.read(json, [&](const JsonLeafReader& leaf) {
+        if (getLeafPath(leaf, path, fullPath) && isFiltered(fullPath, path, filter)) {
+            // Set value
+            changes += persistValue(fullPath, leaf.value(), diff);
+        }
+    });
+    return changes;
+}
+
+bool ConfigurationManager::getLeafPath(const JsonLeafReader& leaf, const std::string& path, std::string& fullPath)
+{
+    // <member>/<element>[/<array element>...], a top level value is not a node of the file
+    if (leaf.depth() < 2) {
+        return false;
+    }
+    fullPath.assign(path);
+    for (size_t level = 0; level < leaf.depth(); level++) {
+        if (leaf.key(level).empty()) {
+            throw ConfigurationException("Arrays are not configuration members");
+        }
+        fullPath.append(FILE_SEPARATOR);
+        if (level + 1 < leaf.depth()) {
+            fullPath.append(leaf.key(level));
+        } else {
+            appendAugeasLabel(fullPath, leaf.key(level));
+        }
+    }
+    return true;
+}
 
-        for (itElement = member->begin(); itElement != member->end(); ++itElement) {
-            cxxtools::SerializationInfo* element     = &(*itElement);
-            std::string                  elementName = element->name();
-            std::string                  elementValue, fullPath;
+size_t ConfigurationManager::removeOtherNodes(const std::string& path, const FeatureFilter& filter,
+    const std::unordered_set<std::string>& nodes, FeatureDiff* diff)
+{
+    // Top nodes of the subtrees to remove: not set, while their parent was (or is the file). Comments are kept.
+    std::vector<std::string> removed;
+    char**                   matches  = nullptr;
+    int                      nmatches = aug_match(m_aug->get(), (path + DESCENDANT_NODES).c_str(), &matches);
+    std::string              nodePath;
+    for (int i = 0; i < nmatches; i++) {
+        std::unique_ptr<char, decltype(&free)> match(matches[i], free);
+        nodePath.assign(match.get());
+        if (nodePath.find(COMMENTS_DELIMITER) != std::string::npos || !isFiltered(nodePath, path, filter)) {
+            continue;
+        }
+        normalizePath(nodePath);
+        size_t parent = nodePath.rfind(FILE_SEPARATOR);
+        if (!nodes.count(nodePath) && (parent == path.size() || nodes.count(nodePath.substr(0, parent)))) {
+            removed.emplace_back(match.get());
+        }
+    }
+    free(matches);
 
-            // Build augeas full path and set value
-            if (element->category() == cxxtools::SerializationInfo::Category::Object) {
-                for (const auto& arrayElem : *element) {
-                    fullPath = path + FILE_SEPARATOR + memberName + FILE_SEPARATOR + elementName + FILE_SEPARATOR +
-                               arrayElem.name();
-                    arrayElem.getValue(elementValue);
-                    // Set value
-                    persistValue(fullPath, elementValue);
+    if (diff) {
+        // The top node and its leaves, in document order
+        for (const auto& top : removed) {
+            nmatches = aug_match(m_aug->get(), (top + SUBTREE_NODES).c_str(), &matches);
+            for (int i = 0; i < nmatches; i++) {
+                std::unique_ptr<char, decltype(&free)> match(matches[i], free);
+                const char*                            value = nullptr;
+                aug_get(m_aug->get(), match.get(), &value);
+                if (strstr(match.get(), COMMENTS_DELIMITER) || (!value && i > 0)) {
+                    continue;
+                }
+                ConfigDocument::NodeId section = diff->section(diff->removed, "removed");
+                std::string_view       node    = match.get();
+                node.remove_prefix(std::min(diff->pathSize, node.size()));
+                if (value) {
+                    diff->document.add(section, node, value);
+                } else {
+                    diff->document.add(section, node);
                 }
-            } else {
-                fullPath = path + FILE_SEPARATOR + memberName + FILE_SEPARATOR + elementName;
-                element->getValue(elementValue);
-                // Set value
-                persistValue(fullPath, elementValue);
             }
+            free(matches);
+        }
+    }
+
+    // Last first: the positions of the previous siblings do not change.
+    for (auto it = removed.rbegin(); it != removed.rend(); ++it) {
+        int count = aug_rm(m_aug->get(), it->c_str());
+        log_node("Remove node, %s => %d", it->c_str(), count);
+    }
+    return removed.size();
+}
+
+std::string ConfigurationManager::getSaveError(const std::string& fileName)
+{
+    // Augeas reports the save errors under /augeas/files/<file>/error
+    const char* error     = nullptr;
+    const char* message   = nullptr;
+    std::string errorPath = AUGEAS_ERRORS + fileName + FILE_SEPARATOR "error";
+    aug_get(m_aug->get(), errorPath.c_str(), &error);
+    aug_get(m_aug->get(), (errorPath + FILE_SEPARATOR "message").c_str(), &message);
+    return std::string(error ? error : "") + (message ? std::string(": ") + message : "");
+}
+
+void ConfigurationManager::loadFeatures(const std::vector<std::string>& featureNames)
+{
+    std::set<std::string> files;
+    for (const auto& featureName : featureNames) {
+        if (const FeatureDefinition* feature = m_features.find(featureName)) {
+            files.insert(feature->fileName);
         }
     }
-    return aug_save(m_aug.get());
+    // A restore compares the payload with this tree, then saves it: it must be the content of the files.
+    m_aug->load(files, true);
 }
 
-void ConfigurationManager::persistValue(const std::string& fullPath, const std::string& value)
+bool ConfigurationManager::persistValue(const std::string& fullPath, const std::string& value, FeatureDiff* diff)
 {
-    int setReturn = aug_set(m_aug.get(), fullPath.c_str(), value.c_str());
-    log_debug("Set values, %s = %s => %d", fullPath.c_str(), value.c_str(), setReturn);
+    // Leave the tree (and so the file) untouched when the value is already the right one.
+    const char* current = nullptr;
+    int         found   = aug_get(m_aug->get(), fullPath.c_str(), &current);
+    if (found == 1 && current && value == current) {
+        log_node("Value unchanged, %s = %s", fullPath.c_str(), value.c_str());
+        return false;
+    }
+    if (diff) {
+        std::string path = fullPath.substr(std::min(diff->pathSize, fullPath.size()));
+        if (found == 1) {
+            ConfigDocument::NodeId change = diff->document.add(diff->section(diff->changed, "changed"), path);
+            diff->document.add(change, "from", current ? current : "");
+            diff->document.add(change, "to", value);
+        } else {
+            diff->document.add(diff->section(diff->added, "added"), path, value);
+        }
+    }
+    int setReturn = aug_set(m_aug->get(), fullPath.c_str(), value.c_str());
+    log_node("Set values, %s = %s => %d", fullPath.c_str(), value.c_str(), setReturn);
     if (setReturn == -1) {
         log_error("Error to set the following values, %s = %s", fullPath.c_str(), value.c_str());
+        return false;
     }
+    return true;
 }
 
 void ConfigurationManager::getConfigurationToJson(
-    cxxtools::SerializationInfo& si, std::string& path, std::string& rootMember)
+    augeas* aug, std::string& json, const FeatureDefinition& feature, const FeatureFilter& filter)
 {
-    std::smatch arrayMatch;
-    char**      matches;
-    int         nmatches = aug_match(m_aug.get(), path.c_str(), &matches);
+    const std::string& path        = feature.augeasPath;
+    const std::string& featureName = feature.name;
+    auto               start       = std::chrono::steady_clock::now();
 
-    // no matches, stop it.
-    if (nmatches < 0)
-        return;
+    // The whole file, or only the subtrees of the filter
+    std::vector<std::string> roots;
+    if (filter.empty()) {
+        roots.push_back(path + DESCENDANT_NODES);
+    }
+    for (const auto& subtree : filter) {
+        roots.push_back(path + FILE_SEPARATOR + subtree + SUBTREE_NODES);
+    }
+
+    // The document copies the names and values, released with it once written: the peak is the document and the JSON,
+    // about twice the payload (see fty_config_document).
+    ConfigDocument document;
+    size_t         nodes = 0;
+    for (const auto& root : roots) {
+        // Evaluate the nodes once, they come in document order.
+        int nmatches = aug_defvar(aug, EXPORT_NODES_VAR, root.c_str());
+        if (nmatches > 0) {
+            nodes += static_cast<size_t>(nmatches);
+            document.reserve(nodes + 1);
+            walkMatches(aug, nmatches, document, feature, !filter.empty());
+        }
+    }
+    aug_defvar(aug, EXPORT_NODES_VAR, nullptr);
+    auto walked = std::chrono::steady_clock::now();
+    m_metrics.record("save." + featureName + ".walk", walked - start);
+
+    document.writeJson(json);
+    m_metrics.record("save." + featureName + ".serialize", std::chrono::steady_clock::now() - walked);
+    m_metrics.count("save." + featureName + ".nodes", nodes);
+    m_metrics.count("save." + featureName + ".bytes", json.size());
+}
+
+void ConfigurationManager::walkMatches(
+    augeas* aug, int nmatches, ConfigDocument& document, const FeatureDefinition& feature, bool partial)
+{
+    const std::string& path       = feature.augeasPath;
+    const std::string& rootMember = feature.rootMember;
 
     // Iterate on all matches
     for (int i = 0; i < nmatches; i++) {
-        std::string temp = matches[i];
-        // Skip all comments
-        if (temp.find(COMMENTS_DELIMITER) == std::string::npos) {
-            const char *value, *label;
-            aug_get(m_aug.get(), matches[i], &value);
-            aug_label(m_aug.get(), matches[i], &label);
+        char* match = nullptr;
+        if (aug_ns_path(aug, EXPORT_NODES_VAR, i, &match) < 0 || !match) {
+            continue;
+        }
+        std::unique_ptr<char, decltype(&free)> owner(match, free);
+        std::string_view                       temp(match);
+        // Skip all comments (and their descendants)
+        if (temp.find(COMMENTS_DELIMITER) == std::string_view::npos) {
+            const char *value = nullptr, *label = nullptr;
+            aug_ns_attr(aug, EXPORT_NODES_VAR, i, &value, &label, nullptr);
+            log_node("Export %s = %s", match, value ? value : "(null)");
 
             if (value) {
-                // Find all members to insert
-                std::vector<std::string>     members = findMembersFromMatch(temp, rootMember);
-                cxxtools::SerializationInfo* siTemp  = &(si);
-                for (const auto& elem : members) {
-                    cxxtools::SerializationInfo* siTmp = siTemp->findMember(elem);
-                    if (!siTmp) {
-                        if (elem.compare(members.back()) != 0) {
-                            siTmp  = &(siTemp->addMember(elem));
-                            siTemp = siTmp;
-                        } else {
-                            siTemp->addMember(label) <<= value;
-                            siTmp  = siTemp->findMember(members.front());
-                            siTemp = siTmp;
-                        }
+                // Walk down the members, the leaf is named after its label (without index)
+                std::string_view       members = findMembersFromMatch(temp, path, rootMember);
+                ConfigDocument::NodeId current = ConfigDocument::ROOT;
+                std::string_view       elem;
+                while (nextMember(members, elem)) {
+                    ConfigDocument::NodeId child = document.find(current, elem);
+                    if (child != ConfigDocument::NONE) {
+                        current = child;
+                    } else if (!members.empty()) {
+                        current = document.add(current, elem);
+                    } else if (uint32_t position; partial && getPosition(elem, position)) {
+                        // Its siblings of the same label may not be exported, keep its rank.
+                        document.add(current, label, value, position - 1);
                     } else {
-                        // Reset pointer
-                        siTmp  = siTemp->findMember(elem);
-                        siTemp = siTmp;
+                        document.add(current, label, value);
                     }
                 }
-            } else if (regex_search(temp, arrayMatch, augeasArrayregex) == true && arrayMatch.str(1).length() > 0) {
+            } else {
                 // In an array case, it's member too.
-                si.addMember(arrayMatch.str(1));
+                std::string_view arrayMember = findArrayMember(temp);
+                if (!arrayMember.empty()) {
+                    document.add(ConfigDocument::ROOT, arrayMember);
+                }
             }
-            getConfigurationToJson(si, temp.append(ANY_NODES), rootMember);
         }
     }
 }
 
-std::vector<std::string> ConfigurationManager::findMembersFromMatch(
-    const std::string& input, const std::string& rootMember)
+bool ConfigurationManager::getPosition(std::string_view member, uint32_t& position)
 {
-    std::vector<std::string> members;
-    if (input.length() > 0) {
-        // Try to find root member
-        std::size_t found = input.find(rootMember);
-        if (found != std::string::npos) {
-            std::string       remain = input.substr(found + rootMember.size(), input.size());
-            std::string       tmp;
-            std::stringstream ss(remain);
-            while (std::getline(ss, tmp, FILE_SEPARATOR[0])) {
-                if (tmp.size() > 0) {
-                    members.push_back(tmp);
-                }
-            }
+    // <label>[<digits>], as Augeas names the siblings sharing a label
+    size_t open = member.rfind(POSITION_START);
+    if (member.empty() || member.back() != POSITION_END || open == std::string_view::npos ||
+        open + 2 >= member.size()) {
+        return false;
+    }
+    uint32_t value = 0;
+    for (size_t i = open + 1; i < member.size() - 1; i++) {
+        if (member[i] < '0' || member[i] > '9') {
+            return false;
+        }
+        value = value * 10 + static_cast<uint32_t>(member[i] - '0');
+    }
+    position = value;
+    return value > 0;
+}
+
+void ConfigurationManager::normalizePath(std::string& path)
+{
+    // <label>[1] is <label> when it has no sibling of the same label: drop it from every member.
+    size_t pos = 0;
+    while ((pos = path.find("[1]", pos)) != std::string::npos) {
+        size_t end = pos + 3;
+        if (end == path.size() || path[end] == FILE_SEPARATOR[0]) {
+            path.erase(pos, 3);
+        } else {
+            pos = end;
+        }
+    }
+}
+
+bool ConfigurationManager::getFeatureFilter(
+    const messagebus::MetaData& metaData, const std::string& featureName, FeatureFilter& filter)
+{
+    filter.clear();
+    auto it = metaData.find(FEATURE_FILTER_META + featureName);
+    if (it == metaData.end()) {
+        return true;
+    }
+    std::stringstream ss(it->second);
+    std::string       subtree;
+    while (std::getline(ss, subtree, FILTER_SEPARATOR)) {
+        // Relative paths inside the file tree, made of labels and positions only: the save and the restore read them
+        // the same way.
+        bool valid = !subtree.empty() && subtree.front() != FILE_SEPARATOR[0] &&
+                     subtree.back() != FILE_SEPARATOR[0] && subtree.find("//") == std::string::npos;
+        std::string_view members = subtree, member, label;
+        uint32_t         position;
+        while (valid && nextMember(members, member)) {
+            splitPosition(member, label, position);
+            valid = !label.empty() && label != "." && label != ".." &&
+                    label.find_first_of(FILTER_FORBIDDEN) == std::string_view::npos;
+        }
+        if (!valid) {
+            log_error("Invalid filter of %s: '%s'", featureName.c_str(), it->second.c_str());
+            return false;
+        }
+        filter.push_back(subtree);
+    }
+    return true;
+}
+
+bool ConfigurationManager::isFiltered(const std::string& fullPath, const std::string& path, const FeatureFilter& filter)
+{
+    if (filter.empty()) {
+        return true;
+    }
+    // <path>/<subtree>, or one of its descendants
+    if (fullPath.size() <= path.size() + 1 || fullPath.compare(0, path.size(), path) != 0 ||
+        fullPath[path.size()] != FILE_SEPARATOR[0]) {
+        return false;
+    }
+    std::string_view members = std::string_view(fullPath).substr(path.size() + 1);
+    for (const auto& subtree : filter) {
+        if (matchesSubtree(members, subtree)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ConfigurationManager::matchesSubtree(std::string_view members, std::string_view subtree)
+{
+    // As Augeas evaluates the filter on save: a label matches all its positions, a position only itself. A label
+    // without position is the first one.
+    std::string_view member, filterMember, label, filterLabel;
+    uint32_t         position, filterPosition;
+    while (nextMember(subtree, filterMember)) {
+        if (!nextMember(members, member)) {
+            return false;
+        }
+        splitPosition(member, label, position);
+        splitPosition(filterMember, filterLabel, filterPosition);
+        if (label != filterLabel || (filterPosition && std::max(position, 1u) != filterPosition)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ConfigurationManager::splitPosition(std::string_view member, std::string_view& label, uint32_t& position)
+{
+    // <label>[<position>], position 0 when not indexed
+    if (getPosition(member, position)) {
+        label = member.substr(0, member.rfind(POSITION_START));
+    } else {
+        label    = member;
+        position = 0;
+    }
+}
+
+std::string_view ConfigurationManager::findMembersFromMatch(
+    std::string_view input, std::string_view path, std::string_view rootMember)
+{
+    if (input.compare(0, path.size(), path) == 0) {
+        return input.substr(path.size());
+    }
+    // Try to find root member
+    std::size_t found = input.find(rootMember);
+    if (found != std::string_view::npos) {
+        return input.substr(found + rootMember.size());
+    }
+    return {};
+}
+
+bool ConfigurationManager::nextMember(std::string_view& members, std::string_view& member)
+{
+    // Skip separators, an escaped separator is part of the member name.
+    while (!members.empty() && members.front() == FILE_SEPARATOR[0]) {
+        members.remove_prefix(1);
+    }
+    if (members.empty()) {
+        return false;
+    }
+    size_t end = 0;
+    while (end < members.size() && members[end] != FILE_SEPARATOR[0]) {
+        end += (members[end] == '\\') ? 2 : 1;
+    }
+    end    = std::min(end, members.size());
+    member = members.substr(0, end);
+    members.remove_prefix(end);
+    // Ignore trailing separators, so that an empty remainder means the last member.
+    while (!members.empty() && members.front() == FILE_SEPARATOR[0]) {
+        members.remove_prefix(1);
+    }
+    return true;
+}
+
+std::string_view ConfigurationManager::findArrayMember(std::string_view input)
+{
+    // Same as matching (\w+\[.*\])$: from the first word followed by '[' up to a final ']'
+    if (input.empty() || input.back() != ']') {
+        return {};
+    }
+    auto isWord = [](char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+    };
+    size_t start = 0;
+    while (start < input.size()) {
+        if (!isWord(input[start])) {
+            start++;
+            continue;
+        }
+        size_t end = start;
+        while (end < input.size() && isWord(input[end])) {
+            end++;
         }
+        if (end < input.size() && input[end] == '[') {
+            return input.substr(start);
+        }
+        start = end;
     }
-    return members;
+    return {};
 }
 
 void ConfigurationManager::dumpConfiguration(std::string& path)
 {
     char** matches;
-    int    nmatches = aug_match(m_aug.get(), path.c_str(), &matches);
+    int    nmatches = aug_match(m_aug->get(), path.c_str(), &matches);
 
     // Stop if not matches.
     if (nmatches < 0)
@@ -354,8 +1309,8 @@ void ConfigurationManager::dumpConfiguration(std::string& path)
         // Skip all comments
         if (temp.find(COMMENTS_DELIMITER) == std::string::npos) {
             const char *value, *label;
-            aug_get(m_aug.get(), matches[i], &value);
-            aug_label(m_aug.get(), matches[i], &label);
+            aug_get(m_aug->get(), matches[i], &value);
+            aug_label(m_aug->get(), matches[i], &label);
             dumpConfiguration(temp.append(ANY_NODES));
         }
     }
@@ -399,6 +1354,18 @@ int ConfigurationManager::getAugeasFlags(std::string& augeasOpts)
     return returnValue;
 }
 
+void ConfigurationManager::appendAugeasLabel(std::string& path, const std::string& name)
+{
+    // Duplicated labels are indexed in the JSON, address them by position.
+    std::string_view label;
+    uint32_t         ordinal;
+    if (!ConfigDocument::parseIndexedName(name, label, ordinal)) {
+        path.append(name);
+        return;
+    }
+    path.append(label).append("[").append(std::to_string(ordinal + 1)).append("]");
+}
+
 bool ConfigurationManager::isVerstionCompatible(const std::string& version)
 {
     bool comptible      = false;
@@ -411,31 +1378,4 @@ bool ConfigurationManager::isVerstionCompatible(const std::string& version)
     return comptible;
 }
 
-//__>> HOTFIX Network config is not a proper JSON due to several "iface" attribut in the Json
-std::string createIndexForIface(std::string json)
-{
-    std::regex  regex("\"iface\"");
-    std::smatch submatch;
-
-    int         index = 0;
-    std::string output;
-
-    // Search all interface
-    while (std::regex_search(json, submatch, regex)) {
-        // Build resulting string
-        output += std::string(submatch.prefix()) + "\"ifacename[" + std::to_string(index++) + "]\"";
-        // Continue to search with the rest of the string
-        json = submatch.suffix();
-    }
-    // If there is still a suffix, add it
-    output += json;
-
-    return output;
-}
-
-std::string removeIndexForIface(const std::string& json)
-{
-    return std::regex_replace(json, std::regex("\"ifacename\\[.*\\]\""), "\"iface\"");
-}
-//__<< HOTFIX
 } // namespace config
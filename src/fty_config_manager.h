@@ -21,52 +21,228 @@
 
 #pragma once
 
-#include <augeas.h>
+#include "fty_config_augeas.h"
+#include "fty_config_cache.h"
+#include "fty_config_change_notifier.h"
+#include "fty_config_dispatcher.h"
+#include "fty_config_document.h"
+#include "fty_config_factory_defaults.h"
+#include "fty_config_feature_registry.h"
+#include "fty_config_json_reader.h"
+#include "fty_config_metrics.h"
+#include "fty_config_snapshot_store.h"
+#include "fty_config_worker_pool.h"
 #include <cxxtools/serializationinfo.h>
 #include <fty_common_messagebus.h>
 #include <fty_srr_dto.h>
 #include <map>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
 
 /**
  * \brief Agent config server actor
  */
 
 namespace config {
+
+// Message metadata, suffixed by the feature name: content hash of the feature data. A save query may send the
+// last known hash, the data is then only returned if it changed.
+constexpr auto FEATURE_HASH_META = "fty-config.hash.";
+// Reply metadata, suffixed by the feature name: the feature data matches the hash of the query and is not returned.
+constexpr auto FEATURE_UNCHANGED_META = "fty-config.unchanged.";
+// Message metadata: compression of the feature data accepted by the requester ("zstd"), echoed in the reply when
+// applied. Compressed data is recognized by its prefix on restore.
+constexpr auto COMPRESSION_META = "fty-config.compression";
+// Message metadata, suffixed by the feature name: comma separated subtrees of the feature file (Augeas paths relative
+// to the file, e.g. "nut/polling"). Only these subtrees are saved, restored or reset. A path is made of labels, each
+// one optionally indexed: "server/key" is every key of the server, "server/key[2]" only the second one.
+constexpr auto FEATURE_FILTER_META = "fty-config.filter.";
+
+// Message metadata: "true" to run a restore (or reset, or snapshot restore) without writing any file.
+// The reply then holds the changes the restore would make, see FEATURE_DIFF_META.
+constexpr auto DRY_RUN_META = "fty-config.dry-run";
+// Reply metadata of a dry run, suffixed by the feature name: JSON object of the changed leaves (Augeas paths
+// relative to the feature file), {"added": {path: value}, "changed": {path: {"from": value, "to": value}},
+// "removed": {path: value}}. A section without changes is omitted. Only a reset removes nodes: the leaves of a
+// removed subtree are listed, its top node as well, null when it has no value.
+constexpr auto FEATURE_DIFF_META = "fty-config.diff.";
+
+// Request subjects of the agent's own requests, the other requests are SRR queries (the SRR messages can't be
+// extended).
+// LIST_SNAPSHOTS: feature names in the user data (all if none), the reply is a JSON array of the snapshots.
+constexpr auto LIST_SNAPSHOTS_SUBJECT = "LIST_SNAPSHOTS";
+// RESTORE_SNAPSHOT: snapshot ids in the user data, the reply is a SRR restore response.
+constexpr auto RESTORE_SNAPSHOT_SUBJECT = "RESTORE_SNAPSHOT";
+// GET_METRICS: no user data, the reply is the JSON document of the stats file.
+constexpr auto GET_METRICS_SUBJECT = "GET_METRICS";
+
+// Subtrees of a feature file, empty for the whole file
+using FeatureFilter = std::vector<std::string>;
+
+// Changes of a dry-run restore of a feature, the document of FEATURE_DIFF_META
+struct FeatureDiff
+{
+    // Length of the Augeas path of the file and its separator, cut from the reported paths
+    size_t                 pathSize = 0;
+    ConfigDocument         document;
+    ConfigDocument::NodeId added   = ConfigDocument::NONE;
+    ConfigDocument::NodeId changed = ConfigDocument::NONE;
+    ConfigDocument::NodeId removed = ConfigDocument::NONE;
+
+    // Section of the document, added with its first change
+    ConfigDocument::NodeId section(ConfigDocument::NodeId& id, std::string_view name)
+    {
+        if (id == ConfigDocument::NONE) {
+            id = document.add(ConfigDocument::ROOT, name);
+        }
+        return id;
+    }
+};
+
 class ConfigurationManager
 {
 
 public:
-    explicit ConfigurationManager(const std::map<std::string, std::string>& parameters);
-    ~ConfigurationManager() = default;
+    ConfigurationManager(const std::map<std::string, std::string>& parameters, const FeatureRegistry& features);
+    /**
+     * @param parameters Agent parameters
+     * @param features Features handled by the agent
+     * @param msgBus Message bus used instead of the Malamute one (in-process benchmark)
+     */
+    ConfigurationManager(const std::map<std::string, std::string>& parameters, const FeatureRegistry& features,
+        std::unique_ptr<messagebus::MessageBus> msgBus);
+    /**
+     * Offline manager, for the command line: the save and restore engines without any message bus,
+     * no request is received and no change is published.
+     * @throw ConfigurationException (or std::exception) if the engines can not be started
+     */
+    struct Offline
+    {
+    };
+    ConfigurationManager(
+        const std::map<std::string, std::string>& parameters, const FeatureRegistry& features, Offline);
+    ~ConfigurationManager();
+
+    /**
+     * Save features in a file, the features are exported in parallel by the save workers.
+     * The file is a JSON object of the SRR features: {name: {"version": version, "data": payload}}
+     * @param featureNames Features to save, all of them if empty
+     * @param fileName File written, replaced atomically once every feature is saved
+     * @param queryMeta Save options, as in a save query: only the filters are used, the payloads are plain
+     * @return Status of each feature, the file is only written if none failed
+     */
+    std::map<dto::srr::FeatureName, dto::srr::FeatureStatus> saveToFile(const std::vector<std::string>& featureNames,
+        const std::string& fileName, const messagebus::MetaData& queryMeta = {});
+    /**
+     * Restore all the features of a file written by saveToFile, either every feature is restored or none
+     * @param queryMeta Restore options, as in a restore query (dry run, filters)
+     * @param replyMeta Filled as the metadata of a restore reply (dry run changes)
+     * @return Status of each feature
+     * @throw ConfigurationException if the file can not be read or is invalid
+     */
+    std::map<dto::srr::FeatureName, dto::srr::FeatureStatus> restoreFromFile(
+        const std::string& fileName, const messagebus::MetaData& queryMeta, messagebus::MetaData& replyMeta);
+    /**
+     * Reset features to their factory defaults, either every feature is reset or none
+     * @param queryMeta Reset options, as in a restore query (dry run, filters)
+     * @param replyMeta Filled as the metadata of a reset reply (dry run changes)
+     * @return Status of each feature
+     */
+    std::map<dto::srr::FeatureName, dto::srr::FeatureStatus> resetFeatures(const std::vector<std::string>& featureNames,
+        const messagebus::MetaData& queryMeta, messagebus::MetaData& replyMeta);
+    /**
+     * Capture the factory defaults of the features found without one: their current configuration becomes the
+     * one a reset restores. Only meant for the first boot, before any user change.
+     * @return Features captured
+     */
+    std::vector<std::string> captureFactoryDefaults();
 
 private:
     std::map<std::string, std::string> m_parameters;
-    using AugeasSmartPtr = std::unique_ptr<augeas, decltype(&aug_close)>;
-    AugeasSmartPtr                          m_aug;
+    FeatureRegistry                         m_features;
+    Metrics                                 m_metrics;
+    std::unique_ptr<AugeasHandle>           m_aug;
+    std::unique_ptr<AugeasWorkerPool>       m_savePool;
+    std::unique_ptr<ChangeNotifier>         m_notifier;
+    std::unique_ptr<RequestDispatcher>      m_dispatcher;
     std::unique_ptr<messagebus::MessageBus> m_msgBus;
-    dto::srr::SrrQueryProcessor             m_processor;
+    std::mutex                              m_sendMutex;
+    // Shared by the saves, exclusive for the restores and resets
+    RequestMutex                            m_requestMutex;
     std::string                             m_configVersion;
+    FeatureCache                            m_cache;
+    std::unique_ptr<FactoryDefaults>        m_factoryDefaults;
+    std::unique_ptr<SnapshotStore>          m_history;
+    // Restores are exclusive, the reader buffers are reused from one to the next.
+    JsonLeafReader                          m_jsonReader;
 
     void init();
+    void initEngines();
+    void connect();
     void handleRequest(messagebus::Message msg);
+    void processRequest(const messagebus::Message& msg);
+    void publishChange(const std::string& featureName, const std::string& delta);
+    void snapshotFeature(const std::string& featureName);
+    void listSnapshots(const messagebus::Message& msg);
+    void restoreSnapshots(const messagebus::Message& msg);
+    void getMetrics(const messagebus::Message& msg);
+    void loadFeatures(const std::vector<std::string>& featureNames);
 
     // Request processor
-    dto::srr::SaveResponse    saveConfiguration(const dto::srr::SaveQuery& query);
-    dto::srr::RestoreResponse restoreConfiguration(const dto::srr::RestoreQuery& query);
-    dto::srr::ResetResponse   resetConfiguration(const dto::srr::ResetQuery& query);
+    dto::srr::SaveResponse    saveConfiguration(
+        const dto::srr::SaveQuery& query, const messagebus::MetaData& queryMeta, messagebus::MetaData& replyMeta);
+    dto::srr::RestoreResponse restoreConfiguration(
+        const dto::srr::RestoreQuery& query, const messagebus::MetaData& queryMeta, messagebus::MetaData& replyMeta);
+    dto::srr::ResetResponse   resetConfiguration(
+        const dto::srr::ResetQuery& query, const messagebus::MetaData& queryMeta, messagebus::MetaData& replyMeta);
+
+    std::map<dto::srr::FeatureName, dto::srr::FeatureAndStatus> saveFeatures(
+        const std::vector<std::string>& featureNames, const messagebus::MetaData& queryMeta,
+        messagebus::MetaData& replyMeta);
+
+    /**
+     * @param replace The payloads replace the files: the nodes they do not hold are removed (a reset), instead of
+     * being kept (a restore)
+     */
+    std::map<dto::srr::FeatureName, dto::srr::FeatureStatus> restoreFeatures(
+        const std::map<dto::srr::FeatureName, const dto::srr::Feature*>& features,
+        const messagebus::MetaData& queryMeta, messagebus::MetaData& replyMeta, bool replace = false);
 
-    void getConfigurationToJson(cxxtools::SerializationInfo& si, std::string& path, std::string& rootMember);
-    int  setConfiguration(cxxtools::SerializationInfo& si, const std::string& path);
-    void sendResponse(const messagebus::Message& msg, const dto::UserData& userData);
+    void        getConfigurationToJson(
+        augeas* aug, std::string& json, const FeatureDefinition& feature, const FeatureFilter& filter = {});
+    void        walkMatches(
+        augeas* aug, int nmatches, ConfigDocument& document, const FeatureDefinition& feature, bool partial);
+    size_t      setConfiguration(std::string_view json, const std::string& path, const FeatureFilter& filter = {},
+        FeatureDiff* diff = nullptr, bool replace = false);
+    size_t      removeOtherNodes(const std::string& path, const FeatureFilter& filter,
+        const std::unordered_set<std::string>& nodes, FeatureDiff* diff = nullptr);
+    std::string getSaveError(const std::string& fileName);
+    void        sendResponse(
+        const messagebus::Message& msg, const dto::UserData& userData, const messagebus::MetaData& metaData = {});
 
     // Utility
-    std::string              getConfigurationFileName(const std::string& featureName);
-    void                     dumpConfiguration(std::string& path);
-    std::vector<std::string> findMembersFromMatch(const std::string& input, const std::string& rootMember);
-    int                      getAugeasFlags(std::string& augeasOpts);
-    bool                     isVerstionCompatible(const std::string& version);
-    void                     persistValue(const std::string& fullPath, const std::string& value);
+    std::string             getConfigurationFileName(const std::string& featureName);
+    void                    dumpConfiguration(std::string& path);
+    static std::string_view findMembersFromMatch(
+        std::string_view input, std::string_view path, std::string_view rootMember);
+    static bool             nextMember(std::string_view& members, std::string_view& member);
+    static std::string_view findArrayMember(std::string_view input);
+    static void             appendAugeasLabel(std::string& path, const std::string& name);
+    static bool             getPosition(std::string_view member, uint32_t& position);
+    static void             normalizePath(std::string& path);
+    static void             splitPosition(std::string_view member, std::string_view& label, uint32_t& position);
+    static bool             matchesSubtree(std::string_view members, std::string_view subtree);
+    static bool getLeafPath(const JsonLeafReader& leaf, const std::string& path, std::string& fullPath);
+    static bool             getFeatureFilter(
+        const messagebus::MetaData& metaData, const std::string& featureName, FeatureFilter& filter);
+    static bool isFiltered(const std::string& fullPath, const std::string& path, const FeatureFilter& filter);
+    int                     getAugeasFlags(std::string& augeasOpts);
+    bool                    isVerstionCompatible(const std::string& version);
+    bool persistValue(const std::string& fullPath, const std::string& value, FeatureDiff* diff = nullptr);
 };
 
 } // namespace config
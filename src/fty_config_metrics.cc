@@ -0,0 +1,161 @@
+/*  =========================================================================
+    fty_config_metrics - Fty config operation metrics
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+ */
+
+/*
+@header
+    fty_config_metrics - Fty config operation metrics
+@discuss
+    Bucket i of a histogram counts the durations below 2^i microseconds (and above the
+    previous bucket), percentiles are reported as the upper bound of their bucket.
+@end
+ */
+
+#include "fty_config_metrics.h"
+#include "fty_config_document.h"
+#include "fty_config_transaction.h"
+#include <fty_log.h>
+
+namespace config {
+
+void Histogram::record(uint64_t us)
+{
+    size_t bucket = 0;
+    while (bucket < BUCKETS - 1 && (uint64_t(1) << bucket) <= us) {
+        bucket++;
+    }
+    buckets[bucket]++;
+    count++;
+    sum += us;
+    min = std::min(min, us);
+    max = std::max(max, us);
+}
+
+uint64_t Histogram::percentile(double ratio) const
+{
+    uint64_t rank = uint64_t(double(count) * ratio);
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < BUCKETS; bucket++) {
+        seen += buckets[bucket];
+        if (seen > rank) {
+            return std::min(uint64_t(1) << bucket, max);
+        }
+    }
+    return max;
+}
+
+Metrics::Metrics()
+    : m_start(std::chrono::steady_clock::now())
+{
+}
+
+Metrics::~Metrics()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    if (m_dumpThread.joinable()) {
+        m_dumpThread.join();
+    }
+}
+
+void Metrics::record(const std::string& name, std::chrono::steady_clock::duration duration)
+{
+    uint64_t                    us = uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_histograms[name].record(us);
+}
+
+void Metrics::count(const std::string& name, uint64_t value)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_counters[name] += value;
+}
+
+std::string Metrics::toJson() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto        uptime = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - m_start);
+    std::string json   = "{\"uptime_s\":" + std::to_string(uptime.count()) + ",\"histograms\":{";
+    const char* separator = "";
+    for (const auto& item : m_histograms) {
+        const Histogram& histogram = item.second;
+        json += separator;
+        // Names hold feature names, which come from the configuration
+        writeJsonString(json, item.first);
+        json += ":{\"count\":" + std::to_string(histogram.count) +
+                ",\"sum_us\":" + std::to_string(histogram.sum) + ",\"min_us\":" + std::to_string(histogram.min) +
+                ",\"max_us\":" + std::to_string(histogram.max) +
+                ",\"p50_us\":" + std::to_string(histogram.percentile(0.50)) +
+                ",\"p90_us\":" + std::to_string(histogram.percentile(0.90)) +
+                ",\"p99_us\":" + std::to_string(histogram.percentile(0.99)) + ",\"buckets\":{";
+        // Only the used buckets, keyed by their upper bound
+        const char* bucketSeparator = "";
+        for (size_t bucket = 0; bucket < Histogram::BUCKETS; bucket++) {
+            if (histogram.buckets[bucket]) {
+                json += bucketSeparator;
+                json += "\"" + std::to_string(uint64_t(1) << bucket) +
+                        "\":" + std::to_string(histogram.buckets[bucket]);
+                bucketSeparator = ",";
+            }
+        }
+        json += "}}";
+        separator = ",";
+    }
+    json += "},\"counters\":{";
+    separator = "";
+    for (const auto& item : m_counters) {
+        json += separator;
+        writeJsonString(json, item.first);
+        json += ":" + std::to_string(item.second);
+        separator = ",";
+    }
+    json += "}}";
+    return json;
+}
+
+void Metrics::startDump(const std::string& fileName, std::chrono::seconds period)
+{
+    if (period.count() <= 0 || fileName.empty() || m_dumpThread.joinable()) {
+        return;
+    }
+    // Created if needed, as the directories of the other stores
+    size_t separator = fileName.rfind('/');
+    if (separator != std::string::npos && separator > 0 && !makeDirectories(fileName.substr(0, separator))) {
+        log_error("Metrics dump directory of %s can't be created", fileName.c_str());
+    }
+    m_dumpThread = std::thread([this, fileName, period]() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_cv.wait_for(lock, period, [this] {
+            return m_stop;
+        })) {
+            lock.unlock();
+            if (!writeFileAtomically(fileName, toJson(), 0644)) {
+                log_error("Metrics dump in %s failed", fileName.c_str());
+            }
+            lock.lock();
+        }
+    });
+}
+
+} // namespace config
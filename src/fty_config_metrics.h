@@ -0,0 +1,117 @@
+/*  =========================================================================
+    fty_config_metrics - Fty config operation metrics
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace config {
+/**
+ * Latency histogram, with power of two microsecond buckets
+ */
+struct Histogram
+{
+    static constexpr size_t BUCKETS = 32;
+
+    void     record(uint64_t us);
+    uint64_t percentile(double ratio) const;
+
+    uint64_t                       count = 0;
+    uint64_t                       sum   = 0;
+    uint64_t                       min   = UINT64_MAX;
+    uint64_t                       max   = 0;
+    std::array<uint64_t, BUCKETS> buckets{};
+};
+
+/**
+ * Timing histograms and counters of the agent operations, named "<operation>.<feature>.<step>".
+ * Metrics are thread safe, and can be dumped periodically in a JSON stats file.
+ */
+class Metrics
+{
+public:
+    Metrics();
+    ~Metrics();
+
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    void record(const std::string& name, std::chrono::steady_clock::duration duration);
+    void count(const std::string& name, uint64_t value);
+
+    /**
+     * @return All the metrics as a JSON document
+     */
+    std::string toJson() const;
+
+    /**
+     * Dump the metrics in a file every period, until destruction
+     * @param fileName Stats file, replaced atomically
+     * @param period Dump period, nothing is dumped if zero
+     */
+    void startDump(const std::string& fileName, std::chrono::seconds period);
+
+private:
+    mutable std::mutex                    m_mutex;
+    std::chrono::steady_clock::time_point m_start;
+    std::map<std::string, Histogram>      m_histograms;
+    std::map<std::string, uint64_t>       m_counters;
+
+    std::condition_variable m_cv;
+    bool                    m_stop = false;
+    std::thread             m_dumpThread;
+};
+
+/**
+ * Record the duration of a scope
+ */
+class ScopedTimer
+{
+public:
+    ScopedTimer(Metrics& metrics, std::string name)
+        : m_metrics(metrics)
+        , m_name(std::move(name))
+        , m_start(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~ScopedTimer()
+    {
+        m_metrics.record(m_name, std::chrono::steady_clock::now() - m_start);
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    Metrics&                              m_metrics;
+    std::string                           m_name;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+} // namespace config
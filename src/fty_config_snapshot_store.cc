@@ -0,0 +1,502 @@
+/*  =========================================================================
+    fty_config_snapshot_store - Fty config snapshot history
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+ */
+
+/*
+@header
+    fty_config_snapshot_store - Fty config snapshot history
+@discuss
+    The history file is a magic then records: a 16 bytes header (type, size, FNV-1a of the
+    body) and a body. A chunk record holds a piece of snapshot data, a snapshot record the
+    description of a snapshot and the offsets of its chunks. Records are only appended, with
+    a single write synced before the snapshot is visible; a torn record (crash) is cut at
+    the next open. Chunk boundaries come from a rolling hash of the data, so an edit only
+    changes the chunks around it.
+    Dropped snapshots stay in the file until they outnumber the kept ones, the file is then
+    rewritten with the kept snapshots only.
+@end
+ */
+
+#include "fty_config_snapshot_store.h"
+#include "fty_config_cache.h"
+#include "fty_config_exception.h"
+#include "fty_config_transaction.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cinttypes>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <fty_log.h>
+#include <set>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace config {
+
+#define HISTORY_FILE "/history.snap"
+#define TEMP_SUFFIX  ".tmp"
+
+static constexpr char     FILE_MAGIC[8]   = {'F', 'T', 'Y', 'C', 'F', 'G', 'H', '1'};
+static constexpr uint32_t CHUNK_RECORD    = 0x4b4e4843; // "CHNK"
+static constexpr uint32_t SNAPSHOT_RECORD = 0x50414e53; // "SNAP"
+
+// Chunks of 2 to 64 KiB, 8 KiB on average
+static constexpr size_t   MIN_CHUNK  = 2 * 1024;
+static constexpr size_t   MAX_CHUNK  = 64 * 1024;
+static constexpr uint64_t CHUNK_MASK = (uint64_t(1) << 13) - 1;
+
+struct RecordHeader
+{
+    uint32_t type;
+    uint32_t size;
+    uint64_t checksum;
+};
+
+// Gear table of the rolling hash, the same in every run
+static const std::array<uint64_t, 256>& gearTable()
+{
+    static const std::array<uint64_t, 256> table = [] {
+        std::array<uint64_t, 256> values;
+        uint64_t                  seed = 0x9E3779B97F4A7C15ULL;
+        for (auto& value : values) {
+            // splitmix64
+            uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+            z          = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z          = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            value      = z ^ (z >> 31);
+        }
+        return values;
+    }();
+    return table;
+}
+
+// Length of the next chunk of data
+static size_t nextChunk(std::string_view data)
+{
+    if (data.size() <= MIN_CHUNK) {
+        return data.size();
+    }
+    const auto& gear = gearTable();
+    uint64_t    hash = 0;
+    size_t      end  = std::min(data.size(), MAX_CHUNK);
+    for (size_t i = MIN_CHUNK; i < end; i++) {
+        hash = (hash << 1) + gear[static_cast<unsigned char>(data[i])];
+        if ((hash & CHUNK_MASK) == 0) {
+            return i + 1;
+        }
+    }
+    return end;
+}
+
+static void appendRecord(std::string& out, uint32_t type, std::string_view body)
+{
+    RecordHeader header{type, static_cast<uint32_t>(body.size()), fnv1a64(body)};
+    out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.append(body);
+}
+
+static void putU64(std::string& out, uint64_t value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void putString(std::string& out, const std::string& value)
+{
+    uint32_t size = static_cast<uint32_t>(value.size());
+    out.append(reinterpret_cast<const char*>(&size), sizeof(size));
+    out.append(value);
+}
+
+static bool getU64(std::string_view& in, uint64_t& value)
+{
+    if (in.size() < sizeof(value)) {
+        return false;
+    }
+    memcpy(&value, in.data(), sizeof(value));
+    in.remove_prefix(sizeof(value));
+    return true;
+}
+
+static bool getString(std::string_view& in, std::string& value)
+{
+    uint32_t size;
+    if (in.size() < sizeof(size)) {
+        return false;
+    }
+    memcpy(&size, in.data(), sizeof(size));
+    in.remove_prefix(sizeof(size));
+    if (in.size() < size) {
+        return false;
+    }
+    value.assign(in.data(), size);
+    in.remove_prefix(size);
+    return true;
+}
+
+SnapshotStore::SnapshotStore(const std::string& path, size_t maxSnapshots)
+    : m_fileName(path + HISTORY_FILE)
+    , m_maxSnapshots(std::max<size_t>(maxSnapshots, 1))
+{
+    if (!makeDirectories(path)) {
+        log_error("History directory %s can't be created", path.c_str());
+    }
+    open();
+}
+
+SnapshotStore::~SnapshotStore()
+{
+    close();
+}
+
+void SnapshotStore::open()
+{
+    m_fd = ::open(m_fileName.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (m_fd < 0) {
+        throw ConfigurationException("History " + m_fileName + ": " + strerror(errno));
+    }
+    struct stat st;
+    if (fstat(m_fd, &st) != 0) {
+        throw ConfigurationException("History " + m_fileName + ": " + strerror(errno));
+    }
+    m_size = static_cast<uint64_t>(st.st_size);
+    if (m_size == 0) {
+        if (!append(std::string(FILE_MAGIC, sizeof(FILE_MAGIC)))) {
+            throw ConfigurationException("History " + m_fileName + ": can't be written");
+        }
+    }
+    if (!map() || memcmp(m_map, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0) {
+        throw ConfigurationException("History " + m_fileName + ": not a history file");
+    }
+    scan();
+    retain();
+}
+
+void SnapshotStore::close()
+{
+    if (m_map) {
+        munmap(const_cast<char*>(m_map), m_mapSize);
+        m_map     = nullptr;
+        m_mapSize = 0;
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    m_snapshots.clear();
+    m_chunks.clear();
+    m_dropped = 0;
+}
+
+void SnapshotStore::scan()
+{
+    std::set<uint64_t> chunks;
+    uint64_t           offset = sizeof(FILE_MAGIC);
+    while (offset < m_size) {
+        RecordHeader header;
+        if (m_size - offset < sizeof(header)) {
+            break;
+        }
+        memcpy(&header, m_map + offset, sizeof(header));
+        if (m_size - offset - sizeof(header) < header.size) {
+            break;
+        }
+        std::string_view body(m_map + offset + sizeof(header), header.size);
+        if (fnv1a64(body) != header.checksum) {
+            break;
+        }
+
+        if (header.type == CHUNK_RECORD) {
+            m_chunks.emplace(header.checksum, offset);
+            chunks.insert(offset);
+        } else if (header.type == SNAPSHOT_RECORD) {
+            Snapshot snapshot;
+            SnapshotInfo& info = snapshot.info;
+            uint64_t      time, count;
+            if (!getU64(body, info.id) || !getU64(body, time) || !getU64(body, info.size) ||
+                !getString(body, info.featureName) || !getString(body, info.version) ||
+                !getString(body, info.trigger) || !getString(body, info.hash) || !getU64(body, count) ||
+                body.size() != count * sizeof(uint64_t)) {
+                break;
+            }
+            info.time = static_cast<int64_t>(time);
+            snapshot.chunks.resize(count);
+            memcpy(snapshot.chunks.data(), body.data(), body.size());
+            if (!std::all_of(snapshot.chunks.begin(), snapshot.chunks.end(), [&chunks](uint64_t chunk) {
+                    return chunks.count(chunk);
+                })) {
+                break;
+            }
+            m_nextId = std::max(m_nextId, info.id + 1);
+            m_snapshots[info.id] = std::move(snapshot);
+        } else {
+            break;
+        }
+        offset += sizeof(header) + header.size;
+    }
+
+    // Partly written record, left by a crash
+    if (offset < m_size) {
+        log_warning("History %s: cut at %" PRIu64 " of %" PRIu64 " bytes", m_fileName.c_str(), offset, m_size);
+        if (ftruncate(m_fd, static_cast<off_t>(offset)) != 0) {
+            log_error("History %s: %s", m_fileName.c_str(), strerror(errno));
+        }
+        m_size = offset;
+    }
+}
+
+void SnapshotStore::retain()
+{
+    // Newest first, per feature
+    std::map<std::string, size_t> kept;
+    for (auto it = m_snapshots.rbegin(); it != m_snapshots.rend();) {
+        if (++kept[it->second.info.featureName] > m_maxSnapshots) {
+            it = decltype(it)(m_snapshots.erase(std::next(it).base()));
+            m_dropped++;
+        } else {
+            ++it;
+        }
+    }
+}
+
+void SnapshotStore::compact()
+{
+    if (!map()) {
+        return;
+    }
+    // The kept snapshots and their chunks, in a new file renamed over the history
+    std::string                  content(FILE_MAGIC, sizeof(FILE_MAGIC));
+    std::map<uint64_t, uint64_t> moved;
+    for (auto& item : m_snapshots) {
+        Snapshot& snapshot = item.second;
+        for (auto& offset : snapshot.chunks) {
+            auto it = moved.find(offset);
+            if (it == moved.end()) {
+                it = moved.emplace(offset, content.size()).first;
+                appendRecord(content, CHUNK_RECORD, chunk(offset));
+            }
+            offset = it->second;
+        }
+        appendRecord(content, SNAPSHOT_RECORD, encode(snapshot));
+    }
+
+    std::string tempName = m_fileName + TEMP_SUFFIX;
+    int         fd       = ::open(tempName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    bool        written  = fd >= 0 && write(fd, content.data(), content.size()) == ssize_t(content.size()) &&
+                    fsync(fd) == 0;
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    if (!written || rename(tempName.c_str(), m_fileName.c_str()) != 0) {
+        log_error("History %s compaction failed: %s", m_fileName.c_str(), strerror(errno));
+        unlink(tempName.c_str());
+        // Chunk offsets were rewritten, read the file again.
+        reopen();
+        return;
+    }
+    log_debug("History %s compacted to %zu bytes", m_fileName.c_str(), content.size());
+    reopen();
+}
+
+void SnapshotStore::reopen()
+{
+    close();
+    try {
+        open();
+    } catch (std::exception& ex) {
+        // The history is disabled, the agent goes on without it.
+        log_error("History disabled: %s", ex.what());
+        close();
+    }
+}
+
+bool SnapshotStore::map() const
+{
+    if (m_mapSize >= m_size) {
+        return m_map != nullptr;
+    }
+    if (m_map) {
+        munmap(const_cast<char*>(m_map), m_mapSize);
+        m_map     = nullptr;
+        m_mapSize = 0;
+    }
+    void* map = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, m_fd, 0);
+    if (map == MAP_FAILED) {
+        log_error("History %s: %s", m_fileName.c_str(), strerror(errno));
+        return false;
+    }
+    m_map     = static_cast<const char*>(map);
+    m_mapSize = m_size;
+    return true;
+}
+
+bool SnapshotStore::append(const std::string& records)
+{
+    // One write at the end of the valid data, synced: a snapshot is complete or cut at the next open.
+    if (pwrite(m_fd, records.data(), records.size(), static_cast<off_t>(m_size)) != ssize_t(records.size()) ||
+        fdatasync(m_fd) != 0) {
+        log_error("History %s: %s", m_fileName.c_str(), strerror(errno));
+        if (ftruncate(m_fd, static_cast<off_t>(m_size)) != 0) {
+            log_error("History %s: %s", m_fileName.c_str(), strerror(errno));
+        }
+        return false;
+    }
+    m_size += records.size();
+    return true;
+}
+
+std::string_view SnapshotStore::chunk(uint64_t offset) const
+{
+    RecordHeader header;
+    memcpy(&header, m_map + offset, sizeof(header));
+    return std::string_view(m_map + offset + sizeof(header), header.size);
+}
+
+uint64_t SnapshotStore::findChunk(uint64_t hash, std::string_view data) const
+{
+    auto range = m_chunks.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (chunk(it->second) == data) {
+            return it->second;
+        }
+    }
+    return 0;
+}
+
+std::string SnapshotStore::encode(const Snapshot& snapshot) const
+{
+    const SnapshotInfo& info = snapshot.info;
+    std::string         body;
+    putU64(body, info.id);
+    putU64(body, static_cast<uint64_t>(info.time));
+    putU64(body, info.size);
+    putString(body, info.featureName);
+    putString(body, info.version);
+    putString(body, info.trigger);
+    putString(body, info.hash);
+    putU64(body, snapshot.chunks.size());
+    body.append(reinterpret_cast<const char*>(snapshot.chunks.data()), snapshot.chunks.size() * sizeof(uint64_t));
+    return body;
+}
+
+uint64_t SnapshotStore::add(
+    const std::string& featureName, const std::string& version, std::string_view data, const std::string& trigger)
+{
+    std::string                 hash = contentHash(data);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_fd < 0) {
+        return 0;
+    }
+
+    // Unchanged since the last snapshot of the feature
+    for (auto it = m_snapshots.rbegin(); it != m_snapshots.rend(); ++it) {
+        if (it->second.info.featureName == featureName) {
+            if (it->second.info.hash == hash && it->second.info.version == version) {
+                return it->first;
+            }
+            break;
+        }
+    }
+    if (!map()) {
+        return 0;
+    }
+
+    Snapshot      snapshot;
+    SnapshotInfo& info = snapshot.info;
+    info.id            = m_nextId;
+    info.time          = static_cast<int64_t>(std::time(nullptr));
+    info.featureName   = featureName;
+    info.version       = version;
+    info.trigger       = trigger;
+    info.hash          = hash;
+    info.size          = data.size();
+
+    // Only the chunks not yet in the file are written, along with the snapshot.
+    std::string                                 records;
+    std::unordered_multimap<uint64_t, uint64_t> newChunks;
+    for (std::string_view rest = data; !rest.empty();) {
+        std::string_view piece = rest.substr(0, nextChunk(rest));
+        rest.remove_prefix(piece.size());
+        uint64_t pieceHash = fnv1a64(piece);
+        uint64_t offset    = findChunk(pieceHash, piece);
+        // Or repeated in this snapshot
+        auto range = newChunks.equal_range(pieceHash);
+        for (auto it = range.first; !offset && it != range.second; ++it) {
+            RecordHeader header;
+            memcpy(&header, records.data() + (it->second - m_size), sizeof(header));
+            if (std::string_view(records).substr(it->second - m_size + sizeof(header), header.size) == piece) {
+                offset = it->second;
+            }
+        }
+        if (!offset) {
+            offset = m_size + records.size();
+            newChunks.emplace(pieceHash, offset);
+            appendRecord(records, CHUNK_RECORD, piece);
+        }
+        snapshot.chunks.push_back(offset);
+    }
+    appendRecord(records, SNAPSHOT_RECORD, encode(snapshot));
+    if (!append(records)) {
+        return 0;
+    }
+
+    m_chunks.insert(newChunks.begin(), newChunks.end());
+    uint64_t id = m_nextId++;
+    m_snapshots.emplace(id, std::move(snapshot));
+    log_debug("Snapshot %" PRIu64 " of %s: %zu bytes written for %zu", id, featureName.c_str(), records.size(),
+        data.size());
+    retain();
+    if (m_dropped > m_snapshots.size()) {
+        compact();
+    }
+    return id;
+}
+
+std::vector<SnapshotInfo> SnapshotStore::list(const std::string& featureName) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<SnapshotInfo>   snapshots;
+    for (const auto& item : m_snapshots) {
+        if (featureName.empty() || item.second.info.featureName == featureName) {
+            snapshots.push_back(item.second.info);
+        }
+    }
+    return snapshots;
+}
+
+bool SnapshotStore::get(uint64_t id, SnapshotInfo& info, std::string& data) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto                        it = m_snapshots.find(id);
+    if (it == m_snapshots.end() || !map()) {
+        return false;
+    }
+    info = it->second.info;
+    data.clear();
+    data.reserve(info.size);
+    for (uint64_t offset : it->second.chunks) {
+        data.append(chunk(offset));
+    }
+    return true;
+}
+
+} // namespace config
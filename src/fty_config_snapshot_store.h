@@ -0,0 +1,128 @@
+/*  =========================================================================
+    fty_config_snapshot_store - Fty config snapshot history
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace config {
+/**
+ * A snapshot of the history
+ */
+struct SnapshotInfo
+{
+    uint64_t id = 0;
+    // Seconds since the epoch
+    int64_t     time = 0;
+    std::string featureName;
+    std::string version;
+    // What took it: "save" or "change"
+    std::string trigger;
+    // Content hash of the data, see contentHash
+    std::string hash;
+    uint64_t    size = 0;
+};
+
+/**
+ * Rolling history of the feature snapshots, in a single append-only file read through a memory mapping.
+ * The data of a snapshot is split in content-defined chunks stored once: a feature saved again with few
+ * changes only adds the chunks which changed.
+ */
+class SnapshotStore
+{
+public:
+    /**
+     * @param path Directory of the history file, created if needed
+     * @param maxSnapshots Snapshots kept per feature, the oldest ones are dropped
+     * @throw ConfigurationException if the history file can't be opened
+     */
+    SnapshotStore(const std::string& path, size_t maxSnapshots);
+    ~SnapshotStore();
+
+    SnapshotStore(const SnapshotStore&) = delete;
+    SnapshotStore& operator=(const SnapshotStore&) = delete;
+
+    /**
+     * Add a snapshot, unless the data is the one of the last snapshot of the feature
+     * @return Id of the new snapshot, or of the last one if unchanged, 0 on write failure or if the history was
+     * disabled by a failed reopen
+     */
+    uint64_t add(const std::string& featureName, const std::string& version, std::string_view data,
+        const std::string& trigger);
+
+    /**
+     * @param featureName Only the snapshots of this feature, all if empty
+     * @return Snapshots kept, oldest first
+     */
+    std::vector<SnapshotInfo> list(const std::string& featureName = {}) const;
+
+    /**
+     * Read a snapshot
+     * @param info Snapshot description, set on success
+     * @param data Snapshot data, set on success
+     * @return false if the snapshot is unknown (or was dropped)
+     */
+    bool get(uint64_t id, SnapshotInfo& info, std::string& data) const;
+
+private:
+    struct Snapshot
+    {
+        SnapshotInfo info;
+        // File offsets of the chunk records, in data order
+        std::vector<uint64_t> chunks;
+    };
+
+    std::string m_fileName;
+    size_t      m_maxSnapshots;
+    int         m_fd = -1;
+    // Valid length of the file, a torn record at the end is cut at open
+    uint64_t m_size = 0;
+
+    mutable std::mutex  m_mutex;
+    mutable const char* m_map     = nullptr;
+    mutable size_t      m_mapSize = 0;
+
+    std::map<uint64_t, Snapshot> m_snapshots;
+    // Chunk hash => offsets of the chunks with this hash
+    std::unordered_multimap<uint64_t, uint64_t> m_chunks;
+    uint64_t                                    m_nextId  = 1;
+    size_t                                      m_dropped = 0;
+
+    void        open();
+    void        close();
+    void        reopen();
+    void        scan();
+    void        compact();
+    void        retain();
+    bool        map() const;
+    bool        append(const std::string& records);
+    std::string_view chunk(uint64_t offset) const;
+    uint64_t    findChunk(uint64_t hash, std::string_view data) const;
+    std::string encode(const Snapshot& snapshot) const;
+};
+
+} // namespace config
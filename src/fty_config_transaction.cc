@@ -0,0 +1,166 @@
+/*  =========================================================================
+    fty_config_transaction - Fty config file transaction
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+ */
+
+/*
+@header
+    fty_config_transaction - Fty config file transaction
+@discuss
+    A restore applies every feature to the Augeas tree and saves it once. If anything fails,
+    the files already rewritten get their previous content back, written in a temporary
+    file which is synced then renamed over the configuration file.
+@end
+ */
+
+#include "fty_config_transaction.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fty_log.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace config {
+
+#define TEMPORARY_SUFFIX ".fty-config.tmp"
+
+bool FileTransaction::backup(const std::string& fileName)
+{
+    if (m_backups.count(fileName)) {
+        return true;
+    }
+    Backup      backup;
+    struct stat st;
+    if (stat(fileName.c_str(), &st) == 0) {
+        // An existing file is never taken for a missing one: the rollback would remove it.
+        backup.exists = true;
+        backup.mode   = st.st_mode & 07777;
+        backup.uid    = st.st_uid;
+        backup.gid    = st.st_gid;
+        if (!readFile(fileName, backup.content)) {
+            log_error("Backup of %s failed: %s", fileName.c_str(), strerror(errno));
+            return false;
+        }
+    } else if (errno != ENOENT) {
+        log_error("Backup of %s failed: %s", fileName.c_str(), strerror(errno));
+        return false;
+    }
+    m_backups.emplace(fileName, std::move(backup));
+    return true;
+}
+
+bool FileTransaction::rollback() const
+{
+    bool success = true;
+    for (const auto& item : m_backups) {
+        const std::string& fileName = item.first;
+        const Backup&      backup   = item.second;
+        std::string        content;
+        bool               exists = readFile(fileName, content);
+
+        if (!backup.exists) {
+            if (exists && unlink(fileName.c_str()) != 0) {
+                log_error("Rollback of %s failed: %s", fileName.c_str(), strerror(errno));
+                success = false;
+            }
+        } else if (!exists || content != backup.content) {
+            log_warning("Rollback of %s", fileName.c_str());
+            success = writeFileAtomically(fileName, backup.content, backup.mode, backup.uid, backup.gid) && success;
+        }
+    }
+    return success;
+}
+
+bool readFile(const std::string& fileName, std::string& content)
+{
+    int fd = open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    content.clear();
+    char    buffer[8192];
+    ssize_t size;
+    while ((size = read(fd, buffer, sizeof(buffer))) > 0) {
+        content.append(buffer, static_cast<size_t>(size));
+    }
+    close(fd);
+    return size == 0;
+}
+
+bool makeDirectories(const std::string& path)
+{
+    for (size_t pos = path.find('/', 1); !path.empty(); pos = path.find('/', pos + 1)) {
+        std::string directory = path.substr(0, pos);
+        if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+            log_error("Directory %s: %s", directory.c_str(), strerror(errno));
+            return false;
+        }
+        if (pos == std::string::npos) {
+            break;
+        }
+    }
+    return true;
+}
+
+bool writeFileAtomically(const std::string& fileName, const std::string& content, mode_t mode, uid_t uid, gid_t gid)
+{
+    std::string temporary = fileName + TEMPORARY_SUFFIX;
+    int         fd        = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+    if (fd < 0) {
+        log_error("Write of %s failed: %s", fileName.c_str(), strerror(errno));
+        return false;
+    }
+
+    bool        success = true;
+    const char* data    = content.data();
+    size_t      remain  = content.size();
+    while (success && remain > 0) {
+        ssize_t written = write(fd, data, remain);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        success = written > 0;
+        if (success) {
+            data += written;
+            remain -= static_cast<size_t>(written);
+        }
+    }
+    // Only a rollback sets an owner, the one of the file it puts back: a non root caller keeps its own.
+    bool setOwner = uid != static_cast<uid_t>(-1) || gid != static_cast<gid_t>(-1);
+    success       = success && fchmod(fd, mode) == 0 && (!setOwner || fchown(fd, uid, gid) == 0) && fsync(fd) == 0;
+    success       = (close(fd) == 0) && success;
+    success       = success && rename(temporary.c_str(), fileName.c_str()) == 0;
+    if (!success) {
+        log_error("Write of %s failed: %s", fileName.c_str(), strerror(errno));
+        unlink(temporary.c_str());
+        return false;
+    }
+
+    // Make the rename itself durable
+    std::string directory = fileName.substr(0, fileName.find_last_of('/') + 1);
+    int         dirFd     = open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd >= 0) {
+        fsync(dirFd);
+        close(dirFd);
+    }
+    return true;
+}
+
+} // namespace config
@@ -0,0 +1,80 @@
+/*  =========================================================================
+    fty_config_transaction - Fty config file transaction
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <sys/types.h>
+
+namespace config {
+/**
+ * Read a whole file
+ * @return false if the file can not be read
+ */
+bool readFile(const std::string& fileName, std::string& content);
+
+/**
+ * Create a directory and its missing parents (mkdir -p)
+ * @return false if a directory can not be created
+ */
+bool makeDirectories(const std::string& path);
+
+/**
+ * Replace a file: the content is written in a temporary file, synced, then renamed over the file
+ * @param uid, gid Owner of the file, the one of the process when left to -1
+ * @return false on failure, the file is then left untouched
+ */
+bool writeFileAtomically(const std::string& fileName, const std::string& content, mode_t mode,
+    uid_t uid = static_cast<uid_t>(-1), gid_t gid = static_cast<gid_t>(-1));
+
+/**
+ * Keep the content of configuration files before they are rewritten, to put it back on failure
+ */
+class FileTransaction
+{
+public:
+    /**
+     * Keep the current content of a file, only the first call for a given file is taken into account
+     * @param fileName File full path
+     * @return false if the file exists but can't be read, it must not be written then
+     */
+    bool backup(const std::string& fileName);
+
+    /**
+     * Put back the content of every file which changed since its backup, a missing file is removed
+     * @return false if at least one file could not be restored
+     */
+    bool rollback() const;
+
+private:
+    struct Backup
+    {
+        bool        exists = false;
+        std::string content;
+        mode_t      mode = 0;
+        uid_t       uid  = 0;
+        gid_t       gid  = 0;
+    };
+    std::map<std::string, Backup> m_backups;
+};
+
+} // namespace config
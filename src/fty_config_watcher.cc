@@ -0,0 +1,174 @@
+/*  =========================================================================
+    fty_config_watcher - Fty config file watcher
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+ */
+
+/*
+@header
+    fty_config_watcher - Fty config file watcher
+@discuss
+    A burst of writes (a file rewritten line by line, several files restored at once) is
+    reported once: the changes are held until no write is seen during the debounce period,
+    at most MAX_DEBOUNCE periods after the first one.
+@end
+ */
+
+#include "fty_config_watcher.h"
+#include "fty_config_exception.h"
+#include <cerrno>
+#include <cstring>
+#include <fty_log.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace config {
+
+// A file written continuously is still reported
+static constexpr int MAX_DEBOUNCE = 10;
+// Written in place, renamed over or removed
+static constexpr uint32_t WATCH_EVENTS = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE;
+
+FileWatcher::FileWatcher(const std::set<std::string>& files, std::chrono::milliseconds debounce, Listener listener)
+    : m_files(files)
+    , m_debounce(debounce)
+    , m_listener(std::move(listener))
+{
+    m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotify < 0) {
+        throw ConfigurationException(std::string("inotify init failed: ") + strerror(errno));
+    }
+    m_stopEvent = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_stopEvent < 0) {
+        close(m_inotify);
+        throw ConfigurationException(std::string("eventfd init failed: ") + strerror(errno));
+    }
+
+    std::set<std::string> directories;
+    for (const auto& file : m_files) {
+        directories.insert(file.substr(0, std::max<size_t>(file.rfind('/'), 1)));
+    }
+    for (const auto& directory : directories) {
+        int wd = inotify_add_watch(m_inotify, directory.c_str(), WATCH_EVENTS);
+        if (wd < 0) {
+            log_warning("Can't watch %s: %s", directory.c_str(), strerror(errno));
+            continue;
+        }
+        m_directories[wd] = directory == "/" ? "" : directory;
+    }
+    m_thread = std::thread(&FileWatcher::run, this);
+}
+
+FileWatcher::~FileWatcher()
+{
+    stop();
+    close(m_stopEvent);
+    close(m_inotify);
+}
+
+void FileWatcher::stop()
+{
+    if (m_thread.joinable()) {
+        uint64_t one = 1;
+        if (write(m_stopEvent, &one, sizeof(one)) != sizeof(one)) {
+            log_error("File watcher stop failed: %s", strerror(errno));
+        }
+        m_thread.join();
+    }
+}
+
+void FileWatcher::run()
+{
+    using Clock = std::chrono::steady_clock;
+    std::set<std::string> changed;
+    Clock::time_point     first, last;
+    pollfd                fds[2] = {{m_inotify, POLLIN, 0}, {m_stopEvent, POLLIN, 0}};
+
+    while (true) {
+        // Wait for the first change, then for the end of the burst
+        int timeout = -1;
+        if (!changed.empty()) {
+            auto deadline = std::min(last + m_debounce, first + MAX_DEBOUNCE * m_debounce);
+            timeout       = static_cast<int>(std::max<int64_t>(
+                std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count(), 0));
+        }
+        int ready = poll(fds, 2, timeout);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            log_error("File watcher poll failed: %s", strerror(errno));
+            return;
+        }
+        if (fds[1].revents) {
+            return;
+        }
+        if (fds[0].revents & POLLIN) {
+            bool pending = !changed.empty();
+            if (readEvents(changed)) {
+                last = Clock::now();
+                if (!pending) {
+                    first = last;
+                }
+            }
+            continue;
+        }
+        if (!changed.empty()) {
+            std::set<std::string> files;
+            files.swap(changed);
+            try {
+                m_listener(files);
+            } catch (std::exception& ex) {
+                log_error("File change processing failed: %s", ex.what());
+            }
+        }
+    }
+}
+
+bool FileWatcher::readEvents(std::set<std::string>& changed)
+{
+    bool relevant = false;
+    alignas(inotify_event) char buffer[4096];
+    ssize_t                     length;
+    while ((length = read(m_inotify, buffer, sizeof(buffer))) > 0) {
+        const inotify_event* event;
+        for (char* ptr = buffer; ptr < buffer + length; ptr += sizeof(inotify_event) + event->len) {
+            event = reinterpret_cast<const inotify_event*>(ptr);
+            // Events were lost, any file may have changed
+            if (event->mask & IN_Q_OVERFLOW) {
+                changed.insert(m_files.begin(), m_files.end());
+                relevant = true;
+                continue;
+            }
+            auto directory = m_directories.find(event->wd);
+            if (directory == m_directories.end() || event->len == 0) {
+                continue;
+            }
+            std::string file = directory->second + "/" + event->name;
+            if (m_files.count(file)) {
+                changed.insert(std::move(file));
+                relevant = true;
+            }
+        }
+    }
+    return relevant;
+}
+
+} // namespace config
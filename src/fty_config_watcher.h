@@ -0,0 +1,71 @@
+/*  =========================================================================
+    fty_config_watcher - Fty config file watcher
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+
+namespace config {
+/**
+ * Watch configuration files, and report their changes once the writes have settled
+ */
+class FileWatcher
+{
+public:
+    using Listener = std::function<void(const std::set<std::string>& files)>;
+
+    /**
+     * @param files Files to watch, full paths. Their directories are watched, so that files replaced by a rename
+     * (Augeas save, editors) or created later are seen too.
+     * @param debounce Quiet period after the last write before the changes are reported
+     * @param listener Called by the watcher thread with the changed files
+     * @throw ConfigurationException if inotify is not available
+     */
+    FileWatcher(const std::set<std::string>& files, std::chrono::milliseconds debounce, Listener listener);
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    /**
+     * Stop watching, pending changes are dropped
+     */
+    void stop();
+
+private:
+    std::set<std::string>      m_files;
+    std::chrono::milliseconds  m_debounce;
+    Listener                   m_listener;
+    int                        m_inotify   = -1;
+    int                        m_stopEvent = -1;
+    std::map<int, std::string> m_directories;
+    std::thread                m_thread;
+
+    void run();
+    bool readEvents(std::set<std::string>& changed);
+};
+
+} // namespace config
@@ -0,0 +1,104 @@
+/*  =========================================================================
+    fty_config_worker_pool - Fty config augeas worker pool
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+ */
+
+/*
+@header
+    fty_config_worker_pool - Fty config augeas worker pool
+@discuss
+    Augeas handles are not thread safe: each worker initializes its own handle when it
+    starts, and keeps it (with its loaded files) for all the tasks it runs.
+@end
+ */
+
+#include "fty_config_worker_pool.h"
+#include "fty_config_exception.h"
+#include <fty_log.h>
+
+namespace config {
+
+AugeasWorkerPool::AugeasWorkerPool(size_t workers, const std::string& root, const std::string& lensPath,
+    unsigned int flags, const FileLenses& fileLenses)
+    : m_root(root)
+    , m_lensPath(lensPath)
+    , m_flags(flags)
+    , m_fileLenses(fileLenses)
+{
+    for (size_t i = 0; i < std::max<size_t>(workers, 1); i++) {
+        m_threads.emplace_back(&AugeasWorkerPool::run, this);
+    }
+}
+
+AugeasWorkerPool::~AugeasWorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+}
+
+std::future<void> AugeasWorkerPool::post(Task task)
+{
+    std::packaged_task<void(AugeasHandle*)> packagedTask([task](AugeasHandle* aug) {
+        if (!aug) {
+            throw ConfigurationException("Augeas tool initialization failed");
+        }
+        task(*aug);
+    });
+    std::future<void> future = packagedTask.get_future();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_back(std::move(packagedTask));
+    }
+    m_cv.notify_one();
+    return future;
+}
+
+void AugeasWorkerPool::run()
+{
+    std::unique_ptr<AugeasHandle> aug;
+    try {
+        aug = std::make_unique<AugeasHandle>(m_root, m_lensPath, m_flags, m_fileLenses);
+    } catch (std::exception& ex) {
+        log_error("Augeas worker: %s", ex.what());
+    }
+
+    while (true) {
+        std::packaged_task<void(AugeasHandle*)> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this] {
+                return m_stop || !m_tasks.empty();
+            });
+            if (m_tasks.empty()) {
+                return;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task(aug.get());
+    }
+}
+
+} // namespace config
@@ -0,0 +1,85 @@
+/*  =========================================================================
+    fty_config_worker_pool - Fty config augeas worker pool
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+
+#include "fty_config_augeas.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace config {
+/**
+ * Pool of worker threads, each of them owning its own Augeas handle
+ */
+class AugeasWorkerPool
+{
+public:
+    using Task = std::function<void(AugeasHandle& aug)>;
+
+    /**
+     * @param workers Number of worker threads
+     * @param root File system root of the configuration files
+     * @param lensPath Augeas lens path
+     * @param flags Augeas flags
+     * @param fileLenses Lenses of the configuration files, see AugeasHandle
+     */
+    AugeasWorkerPool(size_t workers, const std::string& root, const std::string& lensPath, unsigned int flags,
+        const FileLenses& fileLenses = {});
+    ~AugeasWorkerPool();
+
+    AugeasWorkerPool(const AugeasWorkerPool&) = delete;
+    AugeasWorkerPool& operator=(const AugeasWorkerPool&) = delete;
+
+    /**
+     * Queue a task, run by the first available worker
+     * @return Future set when the task is done, holds the exception thrown by the task if any
+     */
+    std::future<void> post(Task task);
+
+    /**
+     * @return Path of a configuration file in the file system, see AugeasHandle
+     */
+    std::string systemPath(const std::string& fileName) const
+    {
+        return AugeasHandle::systemPath(m_root, fileName);
+    }
+
+private:
+    std::string  m_root;
+    std::string  m_lensPath;
+    unsigned int m_flags;
+    FileLenses   m_fileLenses;
+
+    std::mutex                                          m_mutex;
+    std::condition_variable                             m_cv;
+    std::deque<std::packaged_task<void(AugeasHandle*)>> m_tasks;
+    bool                                                m_stop = false;
+    std::vector<std::thread>                            m_threads;
+
+    void run();
+};
+
+} // namespace config
@@ -0,0 +1,105 @@
+/*  =========================================================================
+    compression - Tests of the feature payload compression
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+ */
+
+#include "fty_config_compression.h"
+#include "fty_config_exception.h"
+#include <catch2/catch.hpp>
+
+using namespace config;
+
+static std::string makeData(size_t size)
+{
+    std::string data;
+    data.reserve(size + 32);
+    for (size_t i = 0; data.size() < size; i++) {
+        data += R"({"key":"value )" + std::to_string(i % 100) + R"("},)";
+    }
+    data.resize(size);
+    return data;
+}
+
+TEST_CASE("A payload is compressed and decompressed", "[compression]")
+{
+    // Frames of every length modulo 3, for the base64 padding
+    for (size_t size = 1000; size < 1010; size++) {
+        std::string data = makeData(size);
+        std::string payload;
+        REQUIRE(compressPayload(data, 3, payload));
+        CHECK(isCompressedPayload(payload));
+        CHECK(payload.size() < data.size());
+        CHECK(decompressPayload(payload) == data);
+    }
+}
+
+TEST_CASE("A payload not worth compressing is sent as it is", "[compression]")
+{
+    std::string payload = "unchanged";
+    CHECK_FALSE(compressPayload(R"({"a":"b"})", 3, payload));
+    CHECK(payload == "unchanged");
+    CHECK_FALSE(isCompressedPayload(R"({"a":"b"})"));
+}
+
+TEST_CASE("The decompressed size is bounded", "[compression]")
+{
+    std::string data(MAX_DATA_SIZE, 'a');
+    std::string payload;
+    REQUIRE(compressPayload(data, 1, payload));
+    CHECK(decompressPayload(payload).size() == MAX_DATA_SIZE);
+
+    data += 'a';
+    REQUIRE(compressPayload(data, 1, payload));
+    CHECK_THROWS_AS(decompressPayload(payload), ConfigurationException);
+}
+
+TEST_CASE("A corrupted payload is rejected", "[compression]")
+{
+    std::string payload;
+    REQUIRE(compressPayload(makeData(1000), 3, payload));
+
+    SECTION("base64 length")
+    {
+        CHECK_THROWS_AS(decompressPayload(payload + "A"), ConfigurationException);
+    }
+    SECTION("base64 character")
+    {
+        payload[payload.size() / 2] = '*';
+        CHECK_THROWS_AS(decompressPayload(payload), ConfigurationException);
+    }
+    SECTION("base64 padding")
+    {
+        CHECK_THROWS_AS(decompressPayload("zstd:AA=A"), ConfigurationException);
+        CHECK_THROWS_AS(decompressPayload("zstd:A=AA"), ConfigurationException);
+    }
+    SECTION("Not a zstd frame")
+    {
+        // base64 of "not a zstd frame"
+        CHECK_THROWS_AS(decompressPayload("zstd:bm90IGEgenN0ZCBmcmFtZQ=="), ConfigurationException);
+    }
+    SECTION("Truncated zstd frame")
+    {
+        payload.resize(payload.size() - 8);
+        CHECK_THROWS_AS(decompressPayload(payload), ConfigurationException);
+    }
+    SECTION("Empty frame")
+    {
+        CHECK_THROWS_AS(decompressPayload(ZSTD_PAYLOAD_PREFIX), ConfigurationException);
+    }
+}
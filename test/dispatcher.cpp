@@ -0,0 +1,80 @@
+/*  =========================================================================
+    dispatcher - Tests of the request dispatcher
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+ */
+
+#include "fty_config_dispatcher.h"
+#include <atomic>
+#include <catch2/catch.hpp>
+#include <chrono>
+#include <future>
+#include <shared_mutex>
+
+using namespace config;
+
+TEST_CASE("Requests run on the workers", "[dispatcher]")
+{
+    std::atomic<int> done{0};
+    {
+        RequestDispatcher dispatcher(2, 1);
+        for (int i = 0; i < 10; i++) {
+            REQUIRE(dispatcher.post([&done] {
+                done++;
+            }));
+        }
+        // Pending requests are run before the workers stop
+        dispatcher.stop();
+        CHECK_FALSE(dispatcher.post([] {}));
+    }
+    CHECK(done == 10);
+}
+
+TEST_CASE("Saves share the request mutex", "[dispatcher]")
+{
+    RequestMutex                   mutex;
+    std::shared_lock<RequestMutex> first(mutex);
+    auto second = std::async(std::launch::async, [&mutex] {
+        std::shared_lock<RequestMutex> lock(mutex);
+    });
+    CHECK(second.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+}
+
+TEST_CASE("A waiting restore goes before the next saves", "[dispatcher]")
+{
+    RequestMutex      mutex;
+    std::atomic<bool> restored{false};
+    auto              save = std::make_unique<std::shared_lock<RequestMutex>>(mutex);
+
+    auto restore = std::async(std::launch::async, [&] {
+        std::unique_lock<RequestMutex> lock(mutex);
+        restored = true;
+    });
+    // The restore is waiting for the first save
+    CHECK(restore.wait_for(std::chrono::milliseconds(100)) == std::future_status::timeout);
+
+    auto nextSave = std::async(std::launch::async, [&] {
+        std::shared_lock<RequestMutex> lock(mutex);
+        return restored.load();
+    });
+    CHECK(nextSave.wait_for(std::chrono::milliseconds(100)) == std::future_status::timeout);
+
+    save.reset();
+    restore.get();
+    CHECK(nextSave.get());
+}
@@ -0,0 +1,115 @@
+/*  =========================================================================
+    document - Tests of the exported document
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+ */
+
+#include "fty_config_document.h"
+#include "fty_config_json_reader.h"
+#include <catch2/catch.hpp>
+#include <map>
+
+using namespace config;
+
+static std::string toJson(const ConfigDocument& document)
+{
+    std::string json;
+    document.writeJson(json);
+    return json;
+}
+
+TEST_CASE("Duplicated siblings are written indexed", "[document]")
+{
+    ConfigDocument         document;
+    ConfigDocument::NodeId server = document.add(ConfigDocument::ROOT, "server");
+    document.add(server, "key", "a");
+    document.add(server, "other", "b");
+    document.add(server, "key", "c");
+    ConfigDocument::NodeId client = document.add(ConfigDocument::ROOT, "client");
+    document.add(client, "key", "d");
+
+    CHECK(toJson(document) == R"({"server":{"keyname[0]":"a","other":"b","keyname[1]":"c"},"client":{"key":"d"}})");
+}
+
+TEST_CASE("iface is always written indexed", "[document]")
+{
+    ConfigDocument document;
+    document.add(ConfigDocument::ROOT, "iface", "eth0");
+    document.add(ConfigDocument::ROOT, "auto");
+    CHECK(toJson(document) == R"({"ifacename[0]":"eth0","auto":null})");
+}
+
+TEST_CASE("A partially exported sibling keeps its rank", "[document]")
+{
+    ConfigDocument         document;
+    ConfigDocument::NodeId server = document.add(ConfigDocument::ROOT, "server");
+    document.add(server, "key", "c", 2);
+    CHECK(toJson(document) == R"({"server":{"keyname[2]":"c"}})");
+}
+
+TEST_CASE("Indexed names are parsed back", "[document]")
+{
+    std::string_view name;
+    uint32_t         ordinal = 0;
+    CHECK(ConfigDocument::parseIndexedName("keyname[12]", name, ordinal));
+    CHECK(name == "key");
+    CHECK(ordinal == 12);
+    CHECK(ConfigDocument::parseIndexedName("ifacename[0]", name, ordinal));
+    CHECK(name == "iface");
+    CHECK(ordinal == 0);
+    // The name of a label ending with "name"
+    CHECK(ConfigDocument::parseIndexedName("hostnamename[1]", name, ordinal));
+    CHECK(name == "hostname");
+
+    CHECK_FALSE(ConfigDocument::parseIndexedName("key", name, ordinal));
+    CHECK_FALSE(ConfigDocument::parseIndexedName("name[1]", name, ordinal));
+    CHECK_FALSE(ConfigDocument::parseIndexedName("keyname[]", name, ordinal));
+    CHECK_FALSE(ConfigDocument::parseIndexedName("keyname[1a]", name, ordinal));
+    CHECK_FALSE(ConfigDocument::parseIndexedName("key[1]", name, ordinal));
+}
+
+TEST_CASE("A document is read back leaf by leaf", "[document]")
+{
+    ConfigDocument         document;
+    ConfigDocument::NodeId server = document.add(ConfigDocument::ROOT, "server");
+    document.add(server, "key", "a \"quoted\"\tvalue\n");
+    document.add(server, "key", "\\u00e9\x01");
+    document.add(ConfigDocument::ROOT, "iface", "lo");
+
+    std::map<std::string, std::string> leaves;
+    JsonLeafReader                     reader;
+    reader.read(toJson(document), [&](const JsonLeafReader& leaf) {
+        std::string path;
+        for (size_t level = 0; level < leaf.depth(); level++) {
+            std::string_view name;
+            uint32_t         ordinal;
+            path += "/";
+            if (ConfigDocument::parseIndexedName(leaf.key(level), name, ordinal)) {
+                path.append(name).append("[").append(std::to_string(ordinal + 1)).append("]");
+            } else {
+                path += leaf.key(level);
+            }
+        }
+        leaves[path] = leaf.value();
+    });
+
+    CHECK(leaves.size() == 3);
+    CHECK(leaves["/server/key[1]"] == "a \"quoted\"\tvalue\n");
+    CHECK(leaves["/server/key[2]"] == "\\u00e9\x01");
+    CHECK(leaves["/iface[1]"] == "lo");
+}
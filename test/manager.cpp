@@ -0,0 +1,219 @@
+/*  =========================================================================
+    manager - Tests of the save and restore engines
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+ */
+
+#include "fty_config_factory_defaults.h"
+#include "test_agent.h"
+#include <catch2/catch.hpp>
+
+using namespace config;
+using namespace config::test;
+
+TEST_CASE("A save after a restore in the same second exports the restored values", "[save]")
+{
+    TestAgent agent;
+    agent.addFeature("test", "test.cfg", "server\n    port = 1111\n");
+
+    // Both Augeas handles (the save worker and the restore one) load the file once.
+    REQUIRE(agent.save("test") == R"({"server":{"port":"1111"}})");
+    REQUIRE(agent.restore("test", R"({"server":{"port":"1111"}})"));
+
+    // The save worker parses the rewritten file, then the restore writes it again in the same second:
+    // the modification time Augeas keeps in the worker tree is the one of the restored file.
+    waitNextSecond();
+    agent.writeFile("test.cfg", "server\n    port = 3333\n");
+    CHECK(agent.save("test") == R"({"server":{"port":"3333"}})");
+    REQUIRE(agent.restore("test", R"({"server":{"port":"2222"}})"));
+    CHECK(agent.save("test") == R"({"server":{"port":"2222"}})");
+}
+
+TEST_CASE("A restore compares the payload with the file rewritten in the same second", "[restore]")
+{
+    TestAgent agent;
+    agent.addFeature("test", "test.cfg", "server\n    port = 1111\n");
+    REQUIRE(agent.restore("test", R"({"server":{"port":"1111"}})"));
+
+    // Same value as the payload in the restore tree, not in the file
+    waitNextSecond();
+    REQUIRE(agent.restore("test", R"({"server":{"port":"2222"}})"));
+    agent.writeFile("test.cfg", "server\n    port = 1111\n");
+    REQUIRE(agent.restore("test", R"({"server":{"port":"2222"}})"));
+    CHECK(agent.readFile("test.cfg") == "server\n    port = 2222\n");
+}
+
+TEST_CASE("Duplicated keys are exported indexed and restored in place", "[save][restore]")
+{
+    TestAgent agent;
+    agent.addFeature("test", "test.cfg", "server\n    key = a\n    other = b\n    key = c\n");
+
+    std::string data = agent.save("test");
+    CHECK(data == R"({"server":{"keyname[0]":"a","other":"b","keyname[1]":"c"}})");
+
+    // keyname[1] is the second key of the file
+    REQUIRE(agent.restore("test", R"({"server":{"keyname[0]":"a","other":"b","keyname[1]":"d"}})"));
+    CHECK(agent.readFile("test.cfg") == "server\n    key = a\n    other = b\n    key = d\n");
+    CHECK(agent.save("test") == R"({"server":{"keyname[0]":"a","other":"b","keyname[1]":"d"}})");
+}
+
+TEST_CASE("A single iface is exported indexed", "[save][restore]")
+{
+    const std::string interfaces = "auto lo\niface lo inet loopback\n";
+    TestAgent         agent;
+    agent.addFeature("network", "interfaces", interfaces, "Interfaces.lns");
+
+    std::string data = agent.save("network");
+    CHECK(data.find(R"("ifacename[0]":"lo")") != std::string::npos);
+    CHECK(data.find(R"("iface":)") == std::string::npos);
+
+    // Restored as it was exported: the file is not changed
+    REQUIRE(agent.restore("network", data));
+    CHECK(agent.readFile("interfaces") == interfaces);
+}
+
+TEST_CASE("Several ifaces round trip", "[save][restore]")
+{
+    TestAgent agent;
+    agent.addFeature("network", "interfaces",
+        "auto lo\niface lo inet loopback\n\niface eth0 inet dhcp\n", "Interfaces.lns");
+
+    std::string data = agent.save("network");
+    CHECK(data.find(R"("ifacename[0]":"lo")") != std::string::npos);
+    CHECK(data.find(R"("ifacename[1]":"eth0")") != std::string::npos);
+
+    REQUIRE(agent.restore("network", data));
+    CHECK(agent.save("network") == data);
+}
+
+TEST_CASE("A partial export keeps the rank of the duplicated key", "[save][restore]")
+{
+    TestAgent agent;
+    agent.addFeature("test", "test.cfg", "server\n    key = a\n    key = b\n    port = 1111\n");
+
+    // Only the second key: its siblings are not exported
+    std::string data = agent.save("test", {{std::string(FEATURE_FILTER_META) + "test", "server/key[2]"}});
+    CHECK(data == R"({"server":{"keyname[1]":"b"}})");
+
+    REQUIRE(agent.restore("test", R"({"server":{"keyname[1]":"c"}})"));
+    CHECK(agent.readFile("test.cfg") == "server\n    key = a\n    key = c\n    port = 1111\n");
+}
+
+TEST_CASE("A filtered save is restored with the same filter", "[save][restore]")
+{
+    TestAgent         agent;
+    const std::string filterMeta = std::string(FEATURE_FILTER_META) + "test";
+    agent.addFeature("test", "test.cfg", "server\n    key = a\n    key = b\n    port = 1111\n");
+
+    // Every key
+    std::string data = agent.save("test", {{filterMeta, "server/key"}});
+    CHECK(data == R"({"server":{"keyname[0]":"a","keyname[1]":"b"}})");
+    agent.writeFile("test.cfg", "server\n    key = x\n    key = y\n    port = 2222\n");
+    REQUIRE(agent.restore("test", data, {{filterMeta, "server/key"}}));
+    CHECK(agent.readFile("test.cfg") == "server\n    key = a\n    key = b\n    port = 2222\n");
+
+    // The first key only
+    data = agent.save("test", {{filterMeta, "server/key[1]"}});
+    CHECK(data == R"({"server":{"keyname[0]":"a"}})");
+    agent.writeFile("test.cfg", "server\n    key = x\n    key = y\n    port = 2222\n");
+    REQUIRE(agent.restore("test", data, {{filterMeta, "server/key[1]"}}));
+    CHECK(agent.readFile("test.cfg") == "server\n    key = a\n    key = y\n    port = 2222\n");
+
+    // Augeas expressions are refused on both sides
+    CHECK(agent.save("test", {{filterMeta, "server/*"}}).empty());
+    CHECK_FALSE(agent.restore("test", data, {{filterMeta, "server/key[. = 'a']"}}));
+}
+
+TEST_CASE("Factory defaults are only captured on demand, once", "[reset]")
+{
+    TestAgent agent;
+    agent.addFeature("test", "test.cfg", "server\n    port = 1111\n");
+    FactoryDefaults defaults(agent.path("factory-defaults"));
+
+    // An offline save does not capture them
+    REQUIRE(agent.save("test") == R"({"server":{"port":"1111"}})");
+    CHECK_FALSE(defaults.has("test"));
+
+    CHECK(agent.manager().captureFactoryDefaults() == std::vector<std::string>{"test"});
+    std::string version, data;
+    REQUIRE(defaults.get("test", version, data));
+    CHECK(data == R"({"server":{"port":"1111"}})");
+
+    // The user configuration never replaces them
+    agent.writeFile("test.cfg", "server\n    port = 2222\n");
+    CHECK(agent.manager().captureFactoryDefaults().empty());
+    REQUIRE(defaults.get("test", version, data));
+    CHECK(data == R"({"server":{"port":"1111"}})");
+}
+
+TEST_CASE("A reset replaces the configuration with the factory defaults", "[reset]")
+{
+    TestAgent agent;
+    agent.addFeature("test", "test.cfg", "# Factory\nserver\n    port = 1111\n    key = a\n");
+    REQUIRE(agent.manager().captureFactoryDefaults().size() == 1);
+
+    // Changed, duplicated and added keys, an added section
+    agent.writeFile("test.cfg", "# Factory\nserver\n    port = 2222\n    key = a\n    key = b\n    timeout = 5\n"
+                                "client\n    port = 3333\n");
+    messagebus::MetaData replyMeta;
+    auto                 mapStatus = agent.manager().resetFeatures({"test"}, {}, replyMeta);
+    REQUIRE(mapStatus["test"].status() == dto::srr::Status::SUCCESS);
+    CHECK(agent.readFile("test.cfg") == "# Factory\nserver\n    port = 1111\n    key = a\n");
+
+    // Nothing left to change
+    mapStatus = agent.manager().resetFeatures({"test"}, {}, replyMeta);
+    REQUIRE(mapStatus["test"].status() == dto::srr::Status::SUCCESS);
+    CHECK(agent.readFile("test.cfg") == "# Factory\nserver\n    port = 1111\n    key = a\n");
+}
+
+TEST_CASE("A reset refuses an unknown feature", "[reset]")
+{
+    TestAgent agent;
+    agent.addFeature("test", "test.cfg", "server\n    port = 1111\n");
+    REQUIRE(agent.manager().captureFactoryDefaults().size() == 1);
+
+    messagebus::MetaData replyMeta;
+    auto                 mapStatus = agent.manager().resetFeatures({"../test"}, {}, replyMeta);
+    CHECK(mapStatus["../test"].status() == dto::srr::Status::FAILED);
+    CHECK(mapStatus["../test"].error().find("unknown feature") != std::string::npos);
+}
+
+TEST_CASE("A dry-run reset reports the added, changed and removed leaves", "[reset]")
+{
+    TestAgent agent;
+    agent.addFeature("test", "test.cfg", "server\n    port = 1111\n    key = a\n");
+    REQUIRE(agent.manager().captureFactoryDefaults().size() == 1);
+
+    const std::string content = "server\n    key = a\n    key = b\n    timeout = 5\nclient\n    port = 3333\n";
+    agent.writeFile("test.cfg", content);
+    messagebus::MetaData replyMeta;
+    auto mapStatus = agent.manager().resetFeatures({"test"}, {{config::DRY_RUN_META, "true"}}, replyMeta);
+    REQUIRE(mapStatus["test"].status() == dto::srr::Status::SUCCESS);
+    CHECK(replyMeta[std::string(config::FEATURE_DIFF_META) + "test"] ==
+          R"({"removed":{"server/key[2]":"b","server/timeout":"5","client":null,"client/port":"3333"},)"
+          R"("added":{"server/port":"1111"}})");
+    CHECK(agent.readFile("test.cfg") == content);
+}
+
+TEST_CASE("A restore keeps the keys its payload does not hold", "[restore]")
+{
+    TestAgent agent;
+    agent.addFeature("test", "test.cfg", "server\n    port = 1111\n    timeout = 5\n");
+    REQUIRE(agent.restore("test", R"({"server":{"port":"2222"}})"));
+    CHECK(agent.readFile("test.cfg") == "server\n    port = 2222\n    timeout = 5\n");
+}
@@ -0,0 +1,146 @@
+/*  =========================================================================
+    test_agent - Offline agent of the tests
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+ */
+
+#include "test_agent.h"
+#include "fty-config.h"
+#include "fty_config_document.h"
+#include "fty_config_json_reader.h"
+#include "fty_config_transaction.h"
+#include <chrono>
+#include <cstdlib>
+#include <ftw.h>
+#include <stdexcept>
+#include <thread>
+
+namespace config::test {
+
+#define SAVED_FILE "saved.json"
+
+static int removeEntry(const char* path, const struct stat*, int, struct FTW*)
+{
+    return remove(path);
+}
+
+TestAgent::TestAgent()
+{
+    char directory[] = "/tmp/fty-config-test-XXXXXX";
+    if (!mkdtemp(directory)) {
+        throw std::runtime_error("Temporary directory can't be created");
+    }
+    m_directory = directory;
+
+    parameters[AGENT_NAME_KEY]            = AGENT_NAME;
+    parameters[AUGEAS_ROOT_KEY]           = m_directory;
+    parameters[SAVE_WORKERS_KEY]          = "1";
+    parameters[COMPRESSION_LEVEL_KEY]     = DEFAULT_COMPRESSION_LEVEL;
+    parameters[AUGEAS_LENS_PATH]          = FTY_CONFIG_LENS_PATH;
+    parameters[AUGEAS_OPTIONS]            = "AUG_NO_MODL_AUTOLOAD";
+    parameters[FACTORY_DEFAULTS_PATH_KEY] = path("factory-defaults");
+    parameters[HISTORY_PATH_KEY]          = path("history");
+    parameters[HISTORY_SIZE_KEY]          = "0";
+    parameters[CONFIG_VERSION_KEY]        = ACTIVE_VERSION;
+}
+
+TestAgent::~TestAgent()
+{
+    m_manager.reset();
+    nftw(m_directory.c_str(), removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+void TestAgent::addFeature(
+    const std::string& name, const std::string& fileName, const std::string& content, const std::string& lens)
+{
+    writeFile(fileName, content);
+    // Below the Augeas root
+    m_features.add(name, "/" + fileName, lens);
+}
+
+std::string TestAgent::path(const std::string& fileName) const
+{
+    return m_directory + "/" + fileName;
+}
+
+void TestAgent::writeFile(const std::string& fileName, const std::string& content) const
+{
+    if (!writeFileAtomically(path(fileName), content, 0600)) {
+        throw std::runtime_error("Can't write " + fileName);
+    }
+}
+
+std::string TestAgent::readFile(const std::string& fileName) const
+{
+    std::string content;
+    if (!config::readFile(path(fileName), content)) {
+        throw std::runtime_error("Can't read " + fileName);
+    }
+    return content;
+}
+
+ConfigurationManager& TestAgent::manager()
+{
+    if (!m_manager) {
+        m_manager = std::make_unique<ConfigurationManager>(parameters, m_features, ConfigurationManager::Offline());
+    }
+    return *m_manager;
+}
+
+std::string TestAgent::save(const std::string& featureName, const messagebus::MetaData& queryMeta)
+{
+    auto mapStatus = manager().saveToFile({featureName}, path(SAVED_FILE), queryMeta);
+    if (mapStatus[featureName].status() != dto::srr::Status::SUCCESS) {
+        return {};
+    }
+    // {name: {"version": version, "data": payload}}
+    std::string    data;
+    JsonLeafReader reader;
+    reader.read(readFile(SAVED_FILE), [&](const JsonLeafReader& leaf) {
+        if (leaf.depth() == 2 && leaf.key(0) == featureName && leaf.key(1) == DATA_MEMBER) {
+            data = leaf.value();
+        }
+    });
+    return data;
+}
+
+bool TestAgent::restore(const std::string& featureName, const std::string& data,
+    const messagebus::MetaData& queryMeta, messagebus::MetaData* replyMeta)
+{
+    std::string saved = "{";
+    writeJsonString(saved, featureName);
+    saved += ":{\"" + std::string(CONFIG_VERSION_KEY) + "\":\"" + ACTIVE_VERSION + "\",\"" + DATA_MEMBER + "\":";
+    writeJsonString(saved, data);
+    saved += "}}";
+    writeFile(SAVED_FILE, saved);
+
+    messagebus::MetaData reply;
+    auto                 mapStatus = manager().restoreFromFile(path(SAVED_FILE), queryMeta, reply);
+    if (replyMeta) {
+        *replyMeta = reply;
+    }
+    return mapStatus[featureName].status() == dto::srr::Status::SUCCESS;
+}
+
+void waitNextSecond()
+{
+    auto now = std::chrono::system_clock::now();
+    std::this_thread::sleep_until(std::chrono::time_point_cast<std::chrono::seconds>(now) + std::chrono::seconds(1));
+}
+
+} // namespace config::test
@@ -0,0 +1,95 @@
+/*  =========================================================================
+    test_agent - Offline agent of the tests
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+
+#include "fty_config_feature_registry.h"
+#include "fty_config_manager.h"
+#include <map>
+#include <memory>
+#include <string>
+
+namespace config::test {
+/**
+ * Offline agent on feature files written in a temporary directory, its Augeas root, removed with the agent
+ */
+class TestAgent
+{
+public:
+    TestAgent();
+    ~TestAgent();
+
+    TestAgent(const TestAgent&) = delete;
+    TestAgent& operator=(const TestAgent&) = delete;
+
+    /**
+     * Add a feature, before the first call to manager()
+     * @param name Feature name
+     * @param fileName File name, in the temporary directory
+     * @param content Content of the file
+     * @param lens Augeas lens of the file
+     */
+    void addFeature(const std::string& name, const std::string& fileName, const std::string& content,
+        const std::string& lens = "Zconfig.lns");
+
+    /**
+     * @return Full path of a file of the temporary directory
+     */
+    std::string path(const std::string& fileName) const;
+    void        writeFile(const std::string& fileName, const std::string& content) const;
+    std::string readFile(const std::string& fileName) const;
+
+    /**
+     * @return Manager of the features added, created on the first call
+     */
+    ConfigurationManager& manager();
+
+    /**
+     * Save a feature through a saved configuration file
+     * @param queryMeta Save options
+     * @return Data of the feature, empty if the save failed
+     */
+    std::string save(const std::string& featureName, const messagebus::MetaData& queryMeta = {});
+
+    /**
+     * Restore a feature through a saved configuration file
+     * @param queryMeta Restore options
+     * @param replyMeta Reply metadata, set if not null
+     * @return true on success
+     */
+    bool restore(const std::string& featureName, const std::string& data, const messagebus::MetaData& queryMeta = {},
+        messagebus::MetaData* replyMeta = nullptr);
+
+    // Agent parameters, may be changed before the first call to manager()
+    std::map<std::string, std::string> parameters;
+
+private:
+    std::string                           m_directory;
+    FeatureRegistry                       m_features;
+    std::unique_ptr<ConfigurationManager> m_manager;
+};
+
+/**
+ * Wait for the start of the next second of the wall clock, Augeas compares modification times by the second.
+ */
+void waitNextSecond();
+
+} // namespace config::test
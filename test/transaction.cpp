@@ -0,0 +1,83 @@
+/*  =========================================================================
+    transaction - Tests of the file transaction
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+ */
+
+#include "fty_config_transaction.h"
+#include <catch2/catch.hpp>
+#include <cstdlib>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace config;
+
+namespace {
+struct TemporaryDirectory
+{
+    std::string path;
+
+    TemporaryDirectory()
+    {
+        char name[] = "/tmp/fty-config-transaction-XXXXXX";
+        REQUIRE(mkdtemp(name));
+        path = name;
+    }
+    ~TemporaryDirectory()
+    {
+        std::string command = "rm -rf '" + path + "'";
+        if (system(command.c_str()) != 0) {
+            WARN("Temporary directory " << path << " not removed");
+        }
+    }
+};
+} // namespace
+
+TEST_CASE("A rollback puts back the changed files and removes the new ones", "[transaction]")
+{
+    TemporaryDirectory directory;
+    std::string        changed = directory.path + "/changed.cfg";
+    std::string        added   = directory.path + "/added.cfg";
+    REQUIRE(writeFileAtomically(changed, "before\n", 0640));
+
+    FileTransaction transaction;
+    REQUIRE(transaction.backup(changed));
+    REQUIRE(transaction.backup(added));
+    REQUIRE(writeFileAtomically(changed, "after\n", 0640));
+    REQUIRE(writeFileAtomically(added, "added\n", 0640));
+
+    CHECK(transaction.rollback());
+    std::string content;
+    CHECK(readFile(changed, content));
+    CHECK(content == "before\n");
+    CHECK(access(added.c_str(), F_OK) != 0);
+}
+
+TEST_CASE("A file which can't be read is not backed up, nor removed by the rollback", "[transaction]")
+{
+    TemporaryDirectory directory;
+    // Exists, but reading it fails
+    std::string unreadable = directory.path + "/unreadable";
+    REQUIRE(mkdir(unreadable.c_str(), 0755) == 0);
+
+    FileTransaction transaction;
+    CHECK_FALSE(transaction.backup(unreadable));
+    CHECK(transaction.rollback());
+    struct stat st;
+    CHECK(stat(unreadable.c_str(), &st) == 0);
+}